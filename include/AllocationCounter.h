@@ -0,0 +1,13 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Heap allocations made by the calling thread so far, counted by the global operator
+// new replacements in AllocationCounter.cpp. Used to check that a frame allocates
+// nothing once warmed up.
+uint64_t heapAllocationCount();
+
+// The calling thread's counter, which other threads may read for as long as the
+// thread runs. The job system reads its workers' this way.
+const std::atomic<uint64_t>* threadHeapAllocationCounter();
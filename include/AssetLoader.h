@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+
+using AssetId = int;
+
+// Startup assets built in parallel as jobs. The first frame only waits for the
+// required ones, the others are used by whichever frame finds them ready.
+// Everything a task writes must outlive the loader, which waits for its jobs.
+class AssetLoader {
+public:
+    explicit AssetLoader(JobSystem& jobs);
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    // Starts task as a job. It returns false if the asset could not be built.
+    AssetId load(const std::string& name, bool required, std::function<bool()> task);
+
+    // Finished, whether or not it succeeded
+    bool isDone(AssetId asset) const;
+    // Finished and succeeded, what it wrote may be read from now on
+    bool isReady(AssetId asset) const;
+
+    // Every required asset is ready
+    bool requiredReady() const;
+    // A required asset could not be built
+    bool failed() const;
+
+    int count() const { return static_cast<int>(assets.size()); }
+    int doneCount() const;
+    const std::string& name(AssetId asset) const { return assets[asset]->name; }
+    // From the loader's creation to the asset finishing
+    double milliseconds(AssetId asset) const { return assets[asset]->milliseconds; }
+    // Since the loader was created
+    double elapsedMilliseconds() const;
+
+    void waitAll();
+
+private:
+    // Written by the job before it finishes, read once isDone()
+    struct Asset {
+        std::string name;
+        bool required;
+        bool succeeded = false;
+        double milliseconds = 0.0;
+        JobHandle job = {};
+    };
+
+    JobSystem& jobs;
+    std::chrono::steady_clock::time_point start;
+    std::vector<std::unique_ptr<Asset>> assets;
+};
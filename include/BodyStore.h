@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "BoundingVolumeHierarchy.h"
+
+class JobSystem;
+
+// Index of a body in a BodyStore
+using BodyId = int;
+
+// Parameters of a body, see BodyStore::add(). Speeds are in radians per second.
+struct BodyDesc {
+    float orbitRadius = 0.0f;
+    float orbitSpeed = 0.0f;
+    float orbitPhase = 0.0f;        // Orbit angle at time 0
+    float height = 0.0f;            // Above the orbit plane
+    float spinSpeed = 0.0f;         // About Y
+    float scale = 1.0f;
+    float boundingRadius = 1.0f;    // Of the mesh, before scale
+    float lodPixels = 0.0f;         // Projected radius below which it is drawn as a point, 0 never
+    float mass = 0.0f;              // Only used by the gravity mode, see GravitySimulation
+    uint16_t center = 0;            // Index into the centers passed to resolve()
+    uint16_t material = 0;          // Index into the caller's material table
+    uint16_t mesh = 0;              // Index into the caller's mesh table
+};
+
+// Every orbiting body of the scene as parallel arrays, one entry per body, so the
+// per-frame work runs as vectorised loops over thousands of bodies split across the
+// job system. Orbits and spins are closed-form functions of scene time, see update().
+// Each body orbits one of a small table of centers the caller supplies per frame, e.g.
+// the world position of a planet's scene node for its moons.
+class BodyStore {
+public:
+    BodyId add(const BodyDesc& desc);
+    int size() const { return static_cast<int>(orbitRadii.size()); }
+
+    // Evaluates every orbit offset and spin at a time in seconds. Angles are wrapped to
+    // one turn in double precision before the float sin/cos, so they stay exact however
+    // far into the simulation the time is.
+    void update(double time, JobSystem& jobs);
+
+    // World positions: the center each body orbits plus its orbit offset
+    void resolve(std::span<const glm::vec3> centers, JobSystem& jobs);
+    // Or a world position from elsewhere, e.g. a GravitySimulation
+    void setPosition(BodyId body, const glm::vec3& position) {
+        worldX[body] = position.x;
+        worldY[body] = position.y;
+        worldZ[body] = position.z;
+    }
+
+    // Splits visible bodies into those drawn as meshes and those small enough on screen
+    // to be drawn as points. pixelsPerUnit is the projected size of one unit at distance 1,
+    // projection[1][1] * viewport height / 2.
+    void splitByScreenSize(const std::vector<BodyId>& visible, const glm::mat4& viewProjection, float pixelsPerUnit,
+        std::vector<BodyId>& meshes, std::vector<BodyId>& points) const;
+
+    // translation * scale * rotation about Y, like createModelMatrix(), without any trig
+    glm::mat4 modelMatrix(BodyId body) const;
+
+    // World bounding spheres, for a BoundingVolumeHierarchy over the bodies
+    SphereBounds bounds() const { return SphereBounds{worldX, worldY, worldZ, worldRadii}; }
+
+    glm::vec3 offset(BodyId body) const { return glm::vec3(offsetX[body], offsetY[body], offsetZ[body]); }
+    glm::vec3 position(BodyId body) const { return glm::vec3(worldX[body], worldY[body], worldZ[body]); }
+    float spin(BodyId body) const { return spinAngles[body]; }
+    float scale(BodyId body) const { return scales[body]; }
+    float boundingRadius(BodyId body) const { return worldRadii[body]; }
+    float mass(BodyId body) const { return masses[body]; }
+    float orbitSpeed(BodyId body) const { return orbitSpeeds[body]; }
+    uint16_t center(BodyId body) const { return centers[body]; }
+    uint16_t material(BodyId body) const { return materials[body]; }
+    uint16_t mesh(BodyId body) const { return meshes[body]; }
+
+private:
+    // Parameters
+    std::vector<float> orbitRadii;
+    std::vector<float> orbitSpeeds;
+    std::vector<float> orbitPhases;
+    std::vector<float> heights;
+    std::vector<float> spinSpeeds;
+    std::vector<float> scales;
+    std::vector<float> worldRadii;      // Bounding radius * scale
+    std::vector<float> lodPixels;
+    std::vector<float> masses;
+    std::vector<uint16_t> centers;
+    std::vector<uint16_t> materials;
+    std::vector<uint16_t> meshes;
+    // Results of update()
+    std::vector<float> offsetX, offsetY, offsetZ;
+    std::vector<float> spinAngles, spinCos, spinSin;
+    // Results of resolve()
+    std::vector<float> worldX, worldY, worldZ;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+
+class JobSystem;
+
+// Bounding spheres as parallel arrays, object i at (x[i], y[i], z[i]) with radius[i]
+struct SphereBounds {
+    std::span<const float> x, y, z, radius;
+
+    int size() const { return static_cast<int>(radius.size()); }
+    glm::vec3 center(int object) const { return glm::vec3(x[object], y[object], z[object]); }
+};
+
+// Box of a subtree. Items of every node are a contiguous range of the item order, so
+// a subtree entirely inside the frustum is taken without looking at its objects.
+struct BvhNode {
+    glm::vec3 min = glm::vec3(0);
+    int firstChild = -1;        // Children are firstChild and firstChild + 1, -1 for leaves
+    glm::vec3 max = glm::vec3(0);
+    int firstItem = 0;
+    int itemCount = 0;
+};
+
+// Nearest object along a ray or to a point
+struct BvhHit {
+    int object = -1;            // -1 for no hit
+    float distance = 0.0f;      // Along the ray, or from the point to the sphere's surface
+};
+
+// Bounding volume hierarchy over moving spheres. build() splits with the surface area
+// heuristic, refit() keeps the same tree and only recomputes the boxes, which is cheap
+// but loosens the tree as objects drift apart; degraded() says when to build again.
+// Both copy the spheres in leaf order, so queries answer for the spheres as they were
+// at the last build() or refit() and walk memory in order rather than by object id.
+class BoundingVolumeHierarchy {
+public:
+    void build(const SphereBounds& spheres, JobSystem& jobs);
+    void refit(const SphereBounds& spheres, JobSystem& jobs);
+
+    // Expected cost of a query relative to testing one box, see surfaceAreaCost()
+    float cost() const { return currentCost; }
+    bool degraded() const { return currentCost > REBUILD_COST_RATIO * builtCost; }
+    bool empty() const { return nodes.empty(); }
+    int nodeCount() const { return static_cast<int>(nodes.size()); }
+
+    // Objects intersecting the frustum. Nearer subtrees are visited first, so the result
+    // is roughly front to back from eye, which is the order occluders should be drawn in.
+    void cull(const Frustum& frustum, const glm::vec3& eye, std::vector<int>& visible) const;
+
+    // First sphere hit by the ray, direction normalised
+    BvhHit raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const;
+
+    // Sphere whose surface is closest to point, within maxDistance
+    BvhHit nearest(const glm::vec3& point, float maxDistance) const;
+
+    // A rebuild pays off once refitting made queries this much more expensive
+    static constexpr float REBUILD_COST_RATIO = 1.5f;
+
+private:
+    struct BuildItem {
+        glm::vec4 sphere;
+        int object;
+    };
+
+    void buildNode(int node, int first, int count, int depth, JobSystem& jobs);
+    float surfaceAreaCost() const;
+
+    std::vector<BvhNode> nodes;
+    std::vector<int> items;                 // Object ids, in the order the leaves reference
+    std::vector<glm::vec4> itemSpheres;     // Center and radius of each item
+    std::vector<BuildItem> buildItems;      // Scratch for build(), sorted into leaf order
+    std::vector<int> levelOrder;            // Nodes grouped by depth, for refit()
+    std::vector<int> levelStarts;
+    std::atomic<int> nextNode{0};
+    float builtCost = 0.0f;
+    float currentCost = 0.0f;
+};
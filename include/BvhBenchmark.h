@@ -0,0 +1,13 @@
+#pragma once
+
+#include <span>
+#include <glm/glm.hpp>
+
+class BodyStore;
+class JobSystem;
+
+// Times build(), refit() and every query of BoundingVolumeHierarchy over bodies, with
+// views of projection from random points around centers[0], and checks each query
+// against a loop over all the bodies. Logs the results, false if any query disagreed.
+// Run with --benchmark-bvh.
+bool benchmarkBvh(BodyStore& bodies, std::span<const glm::vec3> centers, const glm::mat4& projection, JobSystem& jobs);
@@ -18,6 +18,15 @@ struct Camera {
         viewDirection = glm::normalize(targetPosition - cameraPosition);
     }
 
+    // The camera between two simulation steps, for rendering
+    static Camera interpolate(const Camera& previous, const Camera& current, float alpha) {
+        Camera camera = current;
+        camera.cameraPosition = glm::mix(previous.cameraPosition, current.cameraPosition, alpha);
+        camera.targetPosition = glm::mix(previous.targetPosition, current.targetPosition, alpha);
+        camera.updateViewDirection();
+        return camera;
+    }
+
     // Recalculate the camera's viewDirection vector
     void updateViewDirection() {
         viewDirection = glm::normalize(targetPosition - cameraPosition);
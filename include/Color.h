@@ -2,9 +2,19 @@
 
 #include <iostream>
 #include <cstdint> // Include for Uint8 definition
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define COLOR_USE_SSE2
+#endif
 
 using Uint8 = uint8_t; // Type alias for unsigned 8-bit integer
+using Uint32 = uint32_t;
 
+// Packed RGBA8 color. The arithmetic operators saturate per channel and run on
+// all four channels at once with SSE2 where available.
 struct Color {
     Uint8 red;
     Uint8 green;
@@ -20,47 +30,88 @@ struct Color {
         alpha = static_cast<Uint8>((a > 255) ? 255 : ((a < 0) ? 0 : a));
     }
 
+    // Channels in 0-1, clamped before the conversion
     Color(float r, float g, float b, float a = 1.0f)
-        : red(static_cast<Uint8>(r * 255.0f)),
-          green(static_cast<Uint8>(g * 255.0f)),
-          blue(static_cast<Uint8>(b * 255.0f)),
-          alpha(static_cast<Uint8>(a * 255.0f)) {
-    
-        red = (red > 255) ? 255 : ((red < 0) ? 0 : red);
-        green = (green > 255) ? 255 : ((green < 0) ? 0 : green);
-        blue = (blue > 255) ? 255 : ((blue < 0) ? 0 : blue);
-        alpha = (alpha > 255) ? 255 : ((alpha < 0) ? 0 : alpha);
+        : red(toChannel(r * 255.0f)),
+          green(toChannel(g * 255.0f)),
+          blue(toChannel(b * 255.0f)),
+          alpha(toChannel(a * 255.0f)) {}
+
+    // The four channels in memory order (red in the lowest byte)
+    Uint32 bits() const {
+        Uint32 value;
+        std::memcpy(&value, this, sizeof(value));
+        return value;
+    }
+
+    static Color fromBits(Uint32 value) {
+        Color color;
+        std::memcpy(static_cast<void*>(&color), &value, sizeof(value));
+        return color;
     }
 
+    // Clamps to 0-255 and truncates, NaN becomes 0
+    static Uint8 toChannel(float value) {
+        return static_cast<Uint8>(std::max(0.0f, std::min(value, 255.0f)));
+    }
+
+    // Saturating add (blend)
     Color operator+(const Color& other) const {
+#ifdef COLOR_USE_SSE2
+        __m128i sum = _mm_adds_epu8(_mm_cvtsi32_si128(static_cast<int>(bits())), _mm_cvtsi32_si128(static_cast<int>(other.bits())));
+        return fromBits(static_cast<Uint32>(_mm_cvtsi128_si32(sum)));
+#else
         int r = static_cast<int>(red) + static_cast<int>(other.red);
         int g = static_cast<int>(green) + static_cast<int>(other.green);
         int b = static_cast<int>(blue) + static_cast<int>(other.blue);
         int a = static_cast<int>(alpha) + static_cast<int>(other.alpha);
-
-        r = (r > 255) ? 255 : ((r < 0) ? 0 : r);
-        g = (g > 255) ? 255 : ((g < 0) ? 0 : g);
-        b = (b > 255) ? 255 : ((b < 0) ? 0 : b);
-        a = (a > 255) ? 255 : ((a < 0) ? 0 : a);
-
         return Color(r, g, b, a);
+#endif
     }
 
+    // Scale the color channels, alpha becomes opaque
     Color operator*(float scalar) const {
-        Uint8 r = static_cast<Uint8>(std::max(0.0f, std::min(red * scalar, 255.0f)));
-        Uint8 g = static_cast<Uint8>(std::max(0.0f, std::min(green * scalar, 255.0f)));
-        Uint8 b = static_cast<Uint8>(std::max(0.0f, std::min(blue * scalar, 255.0f)));
-        Uint8 a = 255;
-        return Color(r, g, b, a);
+#ifdef COLOR_USE_SSE2
+        __m128i zero = _mm_setzero_si128();
+        __m128i channels = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(bits())), zero), zero);
+        // min(255, x) keeps NaN, which truncates to INT_MIN and saturates to 0 below
+        __m128 scaled = _mm_min_ps(_mm_set1_ps(255.0f), _mm_mul_ps(_mm_cvtepi32_ps(channels), _mm_set1_ps(scalar)));
+        __m128i packed = _mm_cvttps_epi32(scaled);
+        packed = _mm_packs_epi32(packed, packed);
+        packed = _mm_packus_epi16(packed, packed);
+        return fromBits(static_cast<Uint32>(_mm_cvtsi128_si32(packed)) | 0xFF000000u);
+#else
+        Color result;
+        result.red = toChannel(red * scalar);
+        result.green = toChannel(green * scalar);
+        result.blue = toChannel(blue * scalar);
+        result.alpha = 255;
+        return result;
+#endif
     }
 
+    // Modulate, (a * b) / 255 per channel
     Color operator*(Color other) const {
-        Uint8 r = static_cast<Uint8>((red * other.red) / 255);
-        Uint8 g = static_cast<Uint8>((green * other.green) / 255);
-        Uint8 b = static_cast<Uint8>((blue * other.blue) / 255);
-        Uint8 a = static_cast<Uint8>((alpha * other.alpha) / 255);
+#ifdef COLOR_USE_SSE2
+        __m128i zero = _mm_setzero_si128();
+        __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(bits())), zero);
+        __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(other.bits())), zero);
+        // x / 255 == (x * 0x8081) >> 23 for every 16-bit x
+        __m128i product = _mm_srli_epi16(_mm_mulhi_epu16(_mm_mullo_epi16(a, b), _mm_set1_epi16(static_cast<short>(0x8081))), 7);
+        return fromBits(static_cast<Uint32>(_mm_cvtsi128_si32(_mm_packus_epi16(product, product))));
+#else
+        Color result;
+        result.red = static_cast<Uint8>((red * other.red) / 255);
+        result.green = static_cast<Uint8>((green * other.green) / 255);
+        result.blue = static_cast<Uint8>((blue * other.blue) / 255);
+        result.alpha = static_cast<Uint8>((alpha * other.alpha) / 255);
+        return result;
+#endif
+    }
 
-        return Color(r, g, b, a);
+    // Pack as 0xAARRGGBB (SDL_PIXELFORMAT_ARGB8888)
+    Uint32 pack() const {
+        return (static_cast<Uint32>(alpha) << 24) | (static_cast<Uint32>(red) << 16) | (static_cast<Uint32>(green) << 8) | static_cast<Uint32>(blue);
     }
 
     bool operator==(const Color& other) const {
@@ -72,7 +123,7 @@ struct Color {
     }
 
     friend std::ostream& operator<<(std::ostream& os, const Color& color) {
-        os << "Color(" 
+        os << "Color("
         << static_cast<int>(color.red) << ", "
         << static_cast<int>(color.green) << ", "
         << static_cast<int>(color.blue) << ", "
@@ -80,3 +131,56 @@ struct Color {
         return os;
     }
 };
+
+// Float working color for shader math. Channels use the same 0-255 scale as Color
+// but nothing is clamped until toColor() or pack(), which convert once at write-out.
+struct alignas(16) ColorF {
+    float red;
+    float green;
+    float blue;
+    float alpha;
+
+    ColorF() : red(255.0f), green(255.0f), blue(255.0f), alpha(255.0f) {}
+
+    ColorF(float r, float g, float b, float a = 255.0f) : red(r), green(g), blue(b), alpha(a) {}
+
+    ColorF(const Color& color)
+        : red(color.red), green(color.green), blue(color.blue), alpha(color.alpha) {}
+
+    ColorF operator+(const ColorF& other) const {
+        return ColorF(red + other.red, green + other.green, blue + other.blue, alpha + other.alpha);
+    }
+
+    // Scale the color channels, alpha is left alone
+    ColorF operator*(float scalar) const {
+        return ColorF(red * scalar, green * scalar, blue * scalar, alpha);
+    }
+
+    // Modulate, (a * b) / 255 per channel
+    ColorF operator*(const ColorF& other) const {
+        const float inv255 = 1.0f / 255.0f;
+        return ColorF(red * other.red * inv255, green * other.green * inv255, blue * other.blue * inv255, alpha * other.alpha * inv255);
+    }
+
+    // Saturate to 0-255 and truncate, NaN becomes 0
+    Color toColor() const {
+#ifdef COLOR_USE_SSE2
+        __m128 channels = _mm_min_ps(_mm_set1_ps(255.0f), _mm_load_ps(&red));
+        __m128i packed = _mm_cvttps_epi32(channels);
+        packed = _mm_packs_epi32(packed, packed);
+        packed = _mm_packus_epi16(packed, packed);
+        return Color::fromBits(static_cast<Uint32>(_mm_cvtsi128_si32(packed)));
+#else
+        Color color;
+        color.red = Color::toChannel(red);
+        color.green = Color::toChannel(green);
+        color.blue = Color::toChannel(blue);
+        color.alpha = Color::toChannel(alpha);
+        return color;
+#endif
+    }
+
+    Uint32 pack() const {
+        return toColor().pack();
+    }
+};
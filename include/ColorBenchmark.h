@@ -0,0 +1,7 @@
+#pragma once
+
+// Times the Earth and red planet shaders' color math per pixel three ways: the scalar
+// Color from before the SSE2 operators, Color as it is now, and ColorF converted once
+// at the end. Logs the results, false if the two Color paths wrote different pixels.
+// Run with --benchmark-color.
+bool benchmarkColor();
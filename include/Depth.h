@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+// Depth is stored as 32-bit unsigned fixed point over the screen-space z range that
+// createViewportMatrix() produces, so depth tests are plain integer compares.
+using Depth = uint32_t;
+
+const float DEPTH_RANGE_MIN = -0.25f;       // ndc z = -1
+const float DEPTH_RANGE_MAX = 1.25f;        // Headroom for geometry past the far plane
+const Depth DEPTH_FARTHEST = 0xFFFFFFFEu;   // Everything at or past DEPTH_RANGE_MAX
+const Depth DEPTH_CLEAR = 0xFFFFFFFFu;      // Cleared depth buffer, behind everything
+
+inline Depth quantizeDepth(float z) {
+    double normalized = (static_cast<double>(z) - DEPTH_RANGE_MIN) / (DEPTH_RANGE_MAX - DEPTH_RANGE_MIN);
+    if (!(normalized > 0.0))
+        return 0;
+    if (normalized >= 1.0)
+        return DEPTH_FARTHEST;
+    return static_cast<Depth>(normalized * DEPTH_FARTHEST);
+}
@@ -52,6 +52,12 @@
 
 #include <cmath>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
 class FastNoiseLite
 {
 public:
@@ -338,6 +344,44 @@ public:
         }
     }
 
+    /// <summary>
+    /// Number of points evaluated per SIMD step by GetNoiseBatch(...)
+    /// </summary>
+    /// <remarks>
+    /// 8 with AVX2, 4 with SSE4.1, otherwise 1
+    /// </remarks>
+#if defined(__AVX2__)
+    static const int BatchWidth = 8;
+#elif defined(__SSE4_1__)
+    static const int BatchWidth = 4;
+#else
+    static const int BatchWidth = 1;
+#endif
+
+    /// <summary>
+    /// 3D noise for a batch of positions stored as separate x, y and z arrays (SoA)
+    /// </summary>
+    /// <remarks>
+    /// Perlin and OpenSimplex2 without fractal are evaluated BatchWidth points at a time,
+    /// matching GetNoise(...) to within float rounding.
+    /// Any other setting, and the tail of the batch, falls back to GetNoise(...) per point.
+    /// </remarks>
+    void GetNoiseBatch(const float* x, const float* y, const float* z, float* out, int count) const
+    {
+        int i = 0;
+
+#if defined(__AVX2__)
+        i = GenNoiseBatch<Batch8>(x, y, z, out, count);
+#elif defined(__SSE4_1__)
+        i = GenNoiseBatch<Batch4>(x, y, z, out, count);
+#endif
+
+        for (; i < count; i++)
+        {
+            out[i] = GetNoise(x[i], y[i], z[i]);
+        }
+    }
+
 
     /// <summary>
     /// 2D warps the input position using current domain warp settings
@@ -1828,6 +1872,285 @@ private:
     }
 
 
+    // Batched (SIMD) Noise
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+    struct Batch4
+    {
+        typedef __m128 F;
+        typedef __m128i I;
+        static const int Width = 4;
+
+        static F Load(const float* p) { return _mm_loadu_ps(p); }
+        static void Store(float* p, F a) { _mm_storeu_ps(p, a); }
+        static F Set(float f) { return _mm_set1_ps(f); }
+        static I SetI(int i) { return _mm_set1_epi32(i); }
+
+        static F Add(F a, F b) { return _mm_add_ps(a, b); }
+        static F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+        static F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+        static F And(F a, F b) { return _mm_and_ps(a, b); }
+        static F Select(F mask, F a, F b) { return _mm_blendv_ps(b, a, mask); }
+        static F GreaterEqual(F a, F b) { return _mm_cmpge_ps(a, b); }
+        static F Greater(F a, F b) { return _mm_cmpgt_ps(a, b); }
+        static F Less(F a, F b) { return _mm_cmplt_ps(a, b); }
+
+        static I AddI(I a, I b) { return _mm_add_epi32(a, b); }
+        static I SubI(I a, I b) { return _mm_sub_epi32(a, b); }
+        static I MulI(I a, I b) { return _mm_mullo_epi32(a, b); }
+        static I XorI(I a, I b) { return _mm_xor_si128(a, b); }
+        static I AndI(I a, I b) { return _mm_and_si128(a, b); }
+        static I OrI(I a, I b) { return _mm_or_si128(a, b); }
+        static I SelectI(F mask, I a, I b) { return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(b), _mm_castsi128_ps(a), mask)); }
+        template <int Shift> static I ShiftRightArithmetic(I a) { return _mm_srai_epi32(a, Shift); }
+
+        static I MaskToI(F mask) { return _mm_castps_si128(mask); }
+        static I Truncate(F a) { return _mm_cvttps_epi32(a); }
+        static F Convert(I a) { return _mm_cvtepi32_ps(a); }
+
+        static F Gather(const float* table, I index)
+        {
+            alignas(16) int lanes[4];
+            _mm_store_si128((__m128i*)lanes, index);
+            return _mm_setr_ps(table[lanes[0]], table[lanes[1]], table[lanes[2]], table[lanes[3]]);
+        }
+    };
+#endif
+
+#if defined(__AVX2__)
+    struct Batch8
+    {
+        typedef __m256 F;
+        typedef __m256i I;
+        static const int Width = 8;
+
+        static F Load(const float* p) { return _mm256_loadu_ps(p); }
+        static void Store(float* p, F a) { _mm256_storeu_ps(p, a); }
+        static F Set(float f) { return _mm256_set1_ps(f); }
+        static I SetI(int i) { return _mm256_set1_epi32(i); }
+
+        static F Add(F a, F b) { return _mm256_add_ps(a, b); }
+        static F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static F And(F a, F b) { return _mm256_and_ps(a, b); }
+        static F Select(F mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+        static F GreaterEqual(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static F Greater(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static F Less(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+
+        static I AddI(I a, I b) { return _mm256_add_epi32(a, b); }
+        static I SubI(I a, I b) { return _mm256_sub_epi32(a, b); }
+        static I MulI(I a, I b) { return _mm256_mullo_epi32(a, b); }
+        static I XorI(I a, I b) { return _mm256_xor_si256(a, b); }
+        static I AndI(I a, I b) { return _mm256_and_si256(a, b); }
+        static I OrI(I a, I b) { return _mm256_or_si256(a, b); }
+        static I SelectI(F mask, I a, I b) { return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), mask)); }
+        template <int Shift> static I ShiftRightArithmetic(I a) { return _mm256_srai_epi32(a, Shift); }
+
+        static I MaskToI(F mask) { return _mm256_castps_si256(mask); }
+        static I Truncate(F a) { return _mm256_cvttps_epi32(a); }
+        static F Convert(I a) { return _mm256_cvtepi32_ps(a); }
+
+        static F Gather(const float* table, I index) { return _mm256_i32gather_ps(table, index, 4); }
+    };
+#endif
+
+#if defined(__SSE4_1__) || defined(__AVX2__)
+    // Returns how many points were written, the caller finishes the rest with GetNoise(...)
+    template <typename V>
+    int GenNoiseBatch(const float* x, const float* y, const float* z, float* out, int count) const
+    {
+        if (mFractalType != FractalType_None ||
+            (mNoiseType != NoiseType_Perlin && mNoiseType != NoiseType_OpenSimplex2))
+        {
+            return 0;
+        }
+
+        alignas(32) float xs[V::Width];
+        alignas(32) float ys[V::Width];
+        alignas(32) float zs[V::Width];
+
+        int i = 0;
+        for (; i + V::Width <= count; i += V::Width)
+        {
+            // Frequency and rotation stay scalar so coordinates match GetNoise(...) exactly
+            for (int l = 0; l < V::Width; l++)
+            {
+                xs[l] = x[i + l];
+                ys[l] = y[i + l];
+                zs[l] = z[i + l];
+                TransformNoiseCoordinate(xs[l], ys[l], zs[l]);
+            }
+
+            typename V::F noise = (mNoiseType == NoiseType_Perlin)
+                ? BatchPerlin<V>(mSeed, V::Load(xs), V::Load(ys), V::Load(zs))
+                : BatchOpenSimplex2<V>(mSeed, V::Load(xs), V::Load(ys), V::Load(zs));
+
+            V::Store(out + i, noise);
+        }
+        return i;
+    }
+
+    template <typename V>
+    static typename V::F BatchGradCoord(typename V::I seed, typename V::I xPrimed, typename V::I yPrimed, typename V::I zPrimed,
+        typename V::F xd, typename V::F yd, typename V::F zd)
+    {
+        typename V::I hash = V::XorI(V::XorI(V::XorI(seed, xPrimed), yPrimed), zPrimed);
+        hash = V::MulI(hash, V::SetI(0x27d4eb2d));
+        hash = V::XorI(hash, V::template ShiftRightArithmetic<15>(hash));
+        hash = V::AndI(hash, V::SetI(63 << 2));
+
+        typename V::F xg = V::Gather(Lookup<float>::Gradients3D, hash);
+        typename V::F yg = V::Gather(Lookup<float>::Gradients3D, V::OrI(hash, V::SetI(1)));
+        typename V::F zg = V::Gather(Lookup<float>::Gradients3D, V::OrI(hash, V::SetI(2)));
+
+        return V::Add(V::Add(V::Mul(xd, xg), V::Mul(yd, yg)), V::Mul(zd, zg));
+    }
+
+    template <typename V>
+    static typename V::F BatchLerp(typename V::F a, typename V::F b, typename V::F t)
+    {
+        return V::Add(a, V::Mul(t, V::Sub(b, a)));
+    }
+
+    template <typename V>
+    static typename V::F BatchInterpQuintic(typename V::F t)
+    {
+        typename V::F inner = V::Add(V::Mul(t, V::Sub(V::Mul(t, V::Set(6)), V::Set(15))), V::Set(10));
+        return V::Mul(V::Mul(V::Mul(t, t), t), inner);
+    }
+
+    template <typename V>
+    typename V::F BatchPerlin(int seed, typename V::F x, typename V::F y, typename V::F z) const
+    {
+        typedef typename V::F F;
+        typedef typename V::I I;
+
+        // FastFloor: truncate, then subtract one for negative inputs (compare mask is -1)
+        const F zero = V::Set(0);
+        I x0 = V::AddI(V::Truncate(x), V::MaskToI(V::Less(x, zero)));
+        I y0 = V::AddI(V::Truncate(y), V::MaskToI(V::Less(y, zero)));
+        I z0 = V::AddI(V::Truncate(z), V::MaskToI(V::Less(z, zero)));
+
+        F xd0 = V::Sub(x, V::Convert(x0));
+        F yd0 = V::Sub(y, V::Convert(y0));
+        F zd0 = V::Sub(z, V::Convert(z0));
+        F xd1 = V::Sub(xd0, V::Set(1));
+        F yd1 = V::Sub(yd0, V::Set(1));
+        F zd1 = V::Sub(zd0, V::Set(1));
+
+        F xs = BatchInterpQuintic<V>(xd0);
+        F ys = BatchInterpQuintic<V>(yd0);
+        F zs = BatchInterpQuintic<V>(zd0);
+
+        x0 = V::MulI(x0, V::SetI(PrimeX));
+        y0 = V::MulI(y0, V::SetI(PrimeY));
+        z0 = V::MulI(z0, V::SetI(PrimeZ));
+        I x1 = V::AddI(x0, V::SetI(PrimeX));
+        I y1 = V::AddI(y0, V::SetI(PrimeY));
+        I z1 = V::AddI(z0, V::SetI(PrimeZ));
+
+        I s = V::SetI(seed);
+        F xf00 = BatchLerp<V>(BatchGradCoord<V>(s, x0, y0, z0, xd0, yd0, zd0), BatchGradCoord<V>(s, x1, y0, z0, xd1, yd0, zd0), xs);
+        F xf10 = BatchLerp<V>(BatchGradCoord<V>(s, x0, y1, z0, xd0, yd1, zd0), BatchGradCoord<V>(s, x1, y1, z0, xd1, yd1, zd0), xs);
+        F xf01 = BatchLerp<V>(BatchGradCoord<V>(s, x0, y0, z1, xd0, yd0, zd1), BatchGradCoord<V>(s, x1, y0, z1, xd1, yd0, zd1), xs);
+        F xf11 = BatchLerp<V>(BatchGradCoord<V>(s, x0, y1, z1, xd0, yd1, zd1), BatchGradCoord<V>(s, x1, y1, z1, xd1, yd1, zd1), xs);
+
+        F yf0 = BatchLerp<V>(xf00, xf10, ys);
+        F yf1 = BatchLerp<V>(xf01, xf11, ys);
+
+        return V::Mul(BatchLerp<V>(yf0, yf1, zs), V::Set(0.964921414852142333984375f));
+    }
+
+    template <typename V>
+    typename V::F BatchOpenSimplex2(int seed, typename V::F x, typename V::F y, typename V::F z) const
+    {
+        typedef typename V::F F;
+        typedef typename V::I I;
+
+        // Same lattice walk as SingleOpenSimplex2, with the axis branch turned into selects
+        const F zero = V::Set(0);
+        const I one = V::SetI(1);
+        I i = V::Truncate(V::Add(x, V::Select(V::GreaterEqual(x, zero), V::Set(0.5f), V::Set(-0.5f))));
+        I j = V::Truncate(V::Add(y, V::Select(V::GreaterEqual(y, zero), V::Set(0.5f), V::Set(-0.5f))));
+        I k = V::Truncate(V::Add(z, V::Select(V::GreaterEqual(z, zero), V::Set(0.5f), V::Set(-0.5f))));
+        F x0 = V::Sub(x, V::Convert(i));
+        F y0 = V::Sub(y, V::Convert(j));
+        F z0 = V::Sub(z, V::Convert(k));
+
+        I xNSign = V::OrI(V::Truncate(V::Sub(V::Set(-1.0f), x0)), one);
+        I yNSign = V::OrI(V::Truncate(V::Sub(V::Set(-1.0f), y0)), one);
+        I zNSign = V::OrI(V::Truncate(V::Sub(V::Set(-1.0f), z0)), one);
+
+        F ax0 = V::Mul(V::Convert(xNSign), V::Sub(zero, x0));
+        F ay0 = V::Mul(V::Convert(yNSign), V::Sub(zero, y0));
+        F az0 = V::Mul(V::Convert(zNSign), V::Sub(zero, z0));
+
+        i = V::MulI(i, V::SetI(PrimeX));
+        j = V::MulI(j, V::SetI(PrimeY));
+        k = V::MulI(k, V::SetI(PrimeZ));
+
+        I s = V::SetI(seed);
+        F value = zero;
+        F a = V::Sub(V::Sub(V::Set(0.6f), V::Mul(x0, x0)), V::Add(V::Mul(y0, y0), V::Mul(z0, z0)));
+
+        for (int l = 0; ; l++)
+        {
+            F aa = V::Mul(a, a);
+            value = V::Add(value, V::And(V::Greater(a, zero), V::Mul(V::Mul(aa, aa), BatchGradCoord<V>(s, i, j, k, x0, y0, z0))));
+
+            F xSign = V::Convert(xNSign);
+            F ySign = V::Convert(yNSign);
+            F zSign = V::Convert(zNSign);
+
+            F useX = V::And(V::GreaterEqual(ax0, ay0), V::GreaterEqual(ax0, az0));
+            F useY = V::And(V::Greater(ay0, ax0), V::GreaterEqual(ay0, az0));
+
+            F x1 = V::Select(useX, V::Add(x0, xSign), x0);
+            F y1 = V::Select(useY, V::Add(y0, ySign), y0);
+            F z1 = V::Select(useX, z0, V::Select(useY, z0, V::Add(z0, zSign)));
+
+            F b = V::Add(a, V::Set(1));
+            F bx = V::Sub(b, V::Mul(V::Add(xSign, xSign), x1));
+            F by = V::Sub(b, V::Mul(V::Add(ySign, ySign), y1));
+            F bz = V::Sub(b, V::Mul(V::Add(zSign, zSign), z1));
+            b = V::Select(useX, bx, V::Select(useY, by, bz));
+
+            I i1 = V::SelectI(useX, V::SubI(i, V::MulI(xNSign, V::SetI(PrimeX))), i);
+            I j1 = V::SelectI(useY, V::SubI(j, V::MulI(yNSign, V::SetI(PrimeY))), j);
+            I k1 = V::SelectI(useX, k, V::SelectI(useY, k, V::SubI(k, V::MulI(zNSign, V::SetI(PrimeZ)))));
+
+            F bb = V::Mul(b, b);
+            value = V::Add(value, V::And(V::Greater(b, zero), V::Mul(V::Mul(bb, bb), BatchGradCoord<V>(s, i1, j1, k1, x1, y1, z1))));
+
+            if (l == 1) break;
+
+            ax0 = V::Sub(V::Set(0.5f), ax0);
+            ay0 = V::Sub(V::Set(0.5f), ay0);
+            az0 = V::Sub(V::Set(0.5f), az0);
+
+            x0 = V::Mul(xSign, ax0);
+            y0 = V::Mul(ySign, ay0);
+            z0 = V::Mul(zSign, az0);
+
+            a = V::Add(a, V::Sub(V::Sub(V::Set(0.75f), ax0), V::Add(ay0, az0)));
+
+            i = V::AddI(i, V::AndI(V::template ShiftRightArithmetic<1>(xNSign), V::SetI(PrimeX)));
+            j = V::AddI(j, V::AndI(V::template ShiftRightArithmetic<1>(yNSign), V::SetI(PrimeY)));
+            k = V::AddI(k, V::AndI(V::template ShiftRightArithmetic<1>(zNSign), V::SetI(PrimeZ)));
+
+            xNSign = V::SubI(V::SetI(0), xNSign);
+            yNSign = V::SubI(V::SetI(0), yNSign);
+            zNSign = V::SubI(V::SetI(0), zNSign);
+
+            s = V::XorI(s, V::SetI(-1));
+        }
+
+        return V::Mul(value, V::Set(32.69428253173828125f));
+    }
+#endif
+
+
     // Value Cubic Noise
 
     template <typename FNfloat>
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Small seeded generator (xoshiro128+) for procedural content: a few bytes of state,
+// a handful of instructions per number and the same sequence for the same seed on
+// every platform, unlike std::random_device, std::mt19937 and std::*_distribution.
+// Not for anything that needs to be unpredictable.
+class FastRandom {
+public:
+    explicit FastRandom(uint64_t seed) {
+        // Spread the seed with splitmix64, so nearby seeds give unrelated sequences
+        for (uint32_t& word : state) {
+            seed += 0x9E3779B97F4A7C15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = static_cast<uint32_t>((z ^ (z >> 31)) >> 32);
+        }
+    }
+
+    uint32_t next() {
+        uint32_t result = state[0] + state[3];
+        uint32_t t = state[1] << 9;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = (state[3] << 11) | (state[3] >> 21);
+        return result;
+    }
+
+    // [0, 1), from the top 24 bits which are the well mixed ones
+    float uniform() {
+        return static_cast<float>(next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float uniform(float min, float max) {
+        return min + (max - min) * uniform();
+    }
+
+    // Standard normal distribution (Box-Muller)
+    float normal() {
+        float radius = std::sqrt(-2.0f * std::log(1.0f - uniform()));
+        return radius * std::cos(6.2831853f * uniform());
+    }
+
+private:
+    uint32_t state[4];
+};
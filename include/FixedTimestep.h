@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+
+// Accumulates real time and hands it out as whole simulation steps, so the scene
+// advances at the same rate whatever the frame rate. What is left over is the
+// fraction of a step to interpolate rendered state by.
+class FixedTimestep {
+public:
+    // maxFrameTime caps the time taken from one frame, so a long stall (loading,
+    // a debugger) does not have to be caught up step by step
+    explicit FixedTimestep(double step, double maxFrameTime = 0.25) : stepSeconds(step), maxFrameTime(maxFrameTime) {}
+
+    // Adds the real time since the last frame and returns how many steps to run now
+    int advance(double elapsedSeconds) {
+        accumulator += std::clamp(elapsedSeconds, 0.0, maxFrameTime);
+        int steps = static_cast<int>(accumulator / stepSeconds);
+        accumulator -= steps * stepSeconds;
+        simulatedSteps += steps;
+        return steps;
+    }
+
+    // How far the frame is between the previous step and the latest one, 0-1
+    float alpha() const { return static_cast<float>(accumulator / stepSeconds); }
+
+    double step() const { return stepSeconds; }
+
+    // Simulation time of the latest step
+    double time() const { return static_cast<double>(simulatedSteps) * stepSeconds; }
+
+private:
+    double stepSeconds;
+    double maxFrameTime;
+    double accumulator = 0.0;
+    long long simulatedSteps = 0;
+};
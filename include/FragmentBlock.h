@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include "Depth.h"
+
+// Shading happens in screen-aligned tiles of BLOCK_SIZE x BLOCK_SIZE pixels
+const int BLOCK_SIZE = 8;
+const int BLOCK_PIXELS = BLOCK_SIZE * BLOCK_SIZE;
+
+// Per-pixel values a fragment shader can ask the rasterizer for. Pixel position
+// and quantized depth are always available.
+enum Interpolant : unsigned {
+    INTERPOLATE_Z = 1 << 0,
+    INTERPOLATE_INTENSITY = 1 << 1,
+    INTERPOLATE_NORMAL = 1 << 2,
+    INTERPOLATE_ORIGINAL_POSITION = 1 << 3,
+    INTERPOLATE_ALL = INTERPOLATE_Z | INTERPOLATE_INTENSITY | INTERPOLATE_NORMAL | INTERPOLATE_ORIGINAL_POSITION
+};
+
+// One float per lane of a block
+struct alignas(32) LaneValues {
+    float values[BLOCK_PIXELS] = {};
+
+    float& operator[](int lane) { return values[lane]; }
+    float operator[](int lane) const { return values[lane]; }
+};
+
+// Stand-in for an interpolant the shader did not declare; reading it does not compile
+struct NoLaneValues {};
+
+template <bool Enabled>
+using Lanes = std::conditional_t<Enabled, LaneValues, NoLaneValues>;
+
+// Structure-of-arrays batch of rasterized pixels handed to a fragment shader.
+// Lane i is the pixel (x + i % BLOCK_SIZE, y + i / BLOCK_SIZE); only lanes with
+// their bit set in mask are covered, the others hold stale (but finite) data.
+// Only the interpolants in the Interpolants mask take up space.
+template <unsigned Interpolants>
+struct FragmentBlock
+{
+    int x = 0;          // Tile origin in screen space
+    int y = 0;
+    uint64_t mask = 0;  // Coverage, bit i for lane i
+
+    alignas(32) Depth depth[BLOCK_PIXELS] = {};
+    [[no_unique_address]] Lanes<(Interpolants & INTERPOLATE_Z) != 0> z;
+    [[no_unique_address]] Lanes<(Interpolants & INTERPOLATE_INTENSITY) != 0> intensity;
+    [[no_unique_address]] Lanes<(Interpolants & INTERPOLATE_NORMAL) != 0> normalX;
+    [[no_unique_address]] Lanes<(Interpolants & INTERPOLATE_NORMAL) != 0> normalY;
+    [[no_unique_address]] Lanes<(Interpolants & INTERPOLATE_NORMAL) != 0> normalZ;
+    [[no_unique_address]] Lanes<(Interpolants & INTERPOLATE_ORIGINAL_POSITION) != 0> originalX;
+    [[no_unique_address]] Lanes<(Interpolants & INTERPOLATE_ORIGINAL_POSITION) != 0> originalY;
+    [[no_unique_address]] Lanes<(Interpolants & INTERPOLATE_ORIGINAL_POSITION) != 0> originalZ;
+
+    int pixelX(int lane) const { return x + lane % BLOCK_SIZE; }
+    int pixelY(int lane) const { return y + lane / BLOCK_SIZE; }
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "JobSystem.h"
+
+const int MAX_PIPELINE_DEPTH = 3;
+
+// Runs the back half of every frame (rasterization, post-processing, resolve) as a job
+// while the main thread simulates and builds the next one. Each frame's job depends on
+// the previous one, so frames render one at a time and in order. A packet goes main
+// thread -> job -> main thread, and the main thread keeps at most depth() packets in
+// flight, which bounds how far presentation lags behind input. Once every packet was
+// made, a frame goes through without touching the heap: render jobs are reused and
+// the queues keep their capacity.
+template <typename Packet>
+class FramePipeline {
+public:
+    using RenderFunction = void (*)(Packet& packet);
+
+    FramePipeline(JobSystem& jobs, RenderFunction render, int depth) : jobs(jobs), render(render) {
+        setDepth(depth);
+        completed.reserve(FRAME_JOBS);
+        freePackets.reserve(FRAME_JOBS);
+    }
+
+    // Finishes the packets already submitted
+    ~FramePipeline() {
+        jobs.wait(lastFrame);
+    }
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    int depth() const { return pipelineDepth; }
+    void setDepth(int depth) { pipelineDepth = std::clamp(depth, 1, MAX_PIPELINE_DEPTH); }
+
+    // Packets submitted but not handed back yet
+    int inFlight() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return inFlightCount;
+    }
+
+    // A packet to record the next frame into, reusing one that was already presented
+    std::unique_ptr<Packet> acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freePackets.empty())
+            return std::make_unique<Packet>();
+        std::unique_ptr<Packet> packet = std::move(freePackets.back());
+        freePackets.pop_back();
+        return packet;
+    }
+
+    void recycle(std::unique_ptr<Packet> packet) {
+        std::lock_guard<std::mutex> lock(mutex);
+        freePackets.push_back(std::move(packet));
+    }
+
+    void submit(std::unique_ptr<Packet> packet) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlightCount++;
+        }
+        // std::function needs a copyable capture, completed takes ownership back. The
+        // capture fits in std::function without allocating.
+        Packet* frame = packet.release();
+        JobHandle& job = frameJobs[nextFrameJob];
+        nextFrameJob = (nextFrameJob + 1) % FRAME_JOBS;
+        jobs.submit(job, [this, frame] {
+            render(*frame);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                completed.emplace_back(frame);
+            }
+            completedChanged.notify_one();
+        }, {lastFrame});
+        lastFrame = job;
+    }
+
+    // Oldest rendered packet, blocks until it is done. Only call with packets in flight.
+    std::unique_ptr<Packet> waitCompleted() {
+        std::unique_lock<std::mutex> lock(mutex);
+        completedChanged.wait(lock, [this] { return !completed.empty(); });
+        return takeCompleted();
+    }
+
+    // Oldest rendered packet, or null if none is done yet
+    std::unique_ptr<Packet> tryCompleted() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (completed.empty())
+            return nullptr;
+        return takeCompleted();
+    }
+
+private:
+    std::unique_ptr<Packet> takeCompleted() {
+        std::unique_ptr<Packet> packet = std::move(completed.front());
+        completed.erase(completed.begin());
+        inFlightCount--;
+        return packet;
+    }
+
+    JobSystem& jobs;
+    RenderFunction render;
+    int pipelineDepth = 1;
+    // One more than can be in flight, so the job submit() reuses is one whose packet
+    // already came back and which has all but finished
+    static const int FRAME_JOBS = MAX_PIPELINE_DEPTH + 1;
+    std::array<JobHandle, FRAME_JOBS> frameJobs;
+    int nextFrameJob = 0;
+    JobHandle lastFrame;            // Render job of the newest submitted frame
+    mutable std::mutex mutex;
+    std::condition_variable completedChanged;
+    std::vector<std::unique_ptr<Packet>> completed;     // Oldest first, never past FRAME_JOBS
+    std::vector<std::unique_ptr<Packet>> freePackets;
+    int inFlightCount = 0;
+};
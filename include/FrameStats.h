@@ -0,0 +1,70 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include "JobSystem.h"
+
+const int MAX_TIMED_PASSES = 8;
+
+// Time spent in one named pass of the frame (post-processing)
+struct PassTiming {
+    const char* name = nullptr;
+    Uint64 counter = 0;
+};
+
+// Per-frame counters shown next to the FPS in the window title
+struct FrameStats {
+    Uint64 shadedPixels = 0;    // Pixels that reached a fragment shader
+    Uint64 shadeCounter = 0;    // SDL performance counter ticks spent inside fragment shaders
+    Uint64 resolveCounter = 0;  // SDL performance counter ticks spent in the HDR resolve
+    PassTiming passTimings[MAX_TIMED_PASSES];
+    int passCount = 0;
+    WorkerCounters workers[MAX_JOB_WORKERS];    // Job system counters over the frame
+    int workerCount = 0;
+    uint64_t workerWindowNanoseconds = 0;       // Time the worker counters cover
+
+    void reset() {
+        *this = FrameStats();
+    }
+
+    // Adds the shading counters another thread collected
+    void addShading(const FrameStats& other) {
+        shadedPixels += other.shadedPixels;
+        shadeCounter += other.shadeCounter;
+    }
+
+    void addPassTime(const char* name, Uint64 counter) {
+        if (passCount < MAX_TIMED_PASSES)
+            passTimings[passCount++] = PassTiming{name, counter};
+    }
+
+    // Shading throughput in millions of pixels per second
+    double shadingMegapixelsPerSecond() const {
+        if (shadeCounter == 0)
+            return 0.0;
+        double seconds = static_cast<double>(shadeCounter) / static_cast<double>(SDL_GetPerformanceFrequency());
+        return static_cast<double>(shadedPixels) / seconds / 1e6;
+    }
+
+    static double milliseconds(Uint64 counter) {
+        return static_cast<double>(counter) * 1000.0 / static_cast<double>(SDL_GetPerformanceFrequency());
+    }
+
+    double resolveMilliseconds() const {
+        return milliseconds(resolveCounter);
+    }
+
+    // Fraction of the frame one job worker spent running tasks
+    double workerUtilisation(int worker) const {
+        if (workerWindowNanoseconds == 0)
+            return 0.0;
+        return static_cast<double>(workers[worker].busyNanoseconds) / static_cast<double>(workerWindowNanoseconds);
+    }
+
+    Uint64 workerSteals() const {
+        Uint64 steals = 0;
+        for (int i = 0; i < workerCount; i++) {
+            steals += workers[i].steals;
+        }
+        return steals;
+    }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Side and near planes of a view-projection, normals pointing inwards and normalised so
+// plane distances are in world units. There is no far plane: the rasterizer doesn't
+// clip against it either, so nothing past it may be culled.
+struct Frustum {
+    static const int PLANE_COUNT = 5;
+    glm::vec4 planes[PLANE_COUNT];  // xyz normal, w distance
+
+    // Planes read off the rows of the matrix (Gribb and Hartmann)
+    static Frustum fromMatrix(const glm::mat4& viewProjection) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        }
+        Frustum frustum;
+        frustum.planes[0] = rows[3] + rows[0];  // Left
+        frustum.planes[1] = rows[3] - rows[0];  // Right
+        frustum.planes[2] = rows[3] + rows[1];  // Bottom
+        frustum.planes[3] = rows[3] - rows[1];  // Top
+        frustum.planes[4] = rows[3] + rows[2];  // Near
+        for (glm::vec4& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3& center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+        return true;
+    }
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+class JobSystem;
+
+// Times GravitySimulation::step() at 10k, 100k and 1M bodies on a disk around a heavy
+// central mass, and steps the same disk on jobs and on a pool of another size to check
+// the result doesn't depend on the thread count. Logs the results, false if the two
+// runs differed. Run with --benchmark-gravity.
+bool benchmarkGravity(JobSystem& jobs);
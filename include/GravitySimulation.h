@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+class JobSystem;
+
+// Cell of the Barnes-Hut octree. Children of a node are contiguous, bodies of a node
+// are a contiguous range of the Morton-sorted order.
+struct GravityNode {
+    glm::vec3 centerOfMass = glm::vec3(0);
+    float mass = 0.0f;
+    float size = 0.0f;          // Edge length of the cell
+    int firstChild = -1;        // -1 for leaves
+    int childCount = 0;
+    int firstBody = 0;
+    int bodyCount = 0;
+};
+
+// N-body gravity: every body attracts every other one, through a Barnes-Hut octree
+// rebuilt each step so a step costs O(n log n). Integrated with kick-drift-kick
+// leapfrog, which is symplectic, so orbits keep their energy over long runs instead
+// of spiralling. Every stage splits work into fixed ranges and sums in a fixed order,
+// so the result does not depend on the thread count or on scheduling.
+class GravitySimulation {
+public:
+    float gravitationalConstant = 1.0f;
+    float theta = 0.6f;         // A cell of size s at distance d is one body if s < theta * d
+    float softening = 0.5f;     // Keeps close encounters finite, must be positive
+
+    void clear();
+    int add(const glm::vec3& position, const glm::vec3& velocity, float mass);
+    int size() const { return static_cast<int>(masses.size()); }
+
+    // Advances by dt seconds
+    void step(float dt, JobSystem& jobs);
+
+    glm::vec3 position(int body) const { return glm::vec3(positionX[body], positionY[body], positionZ[body]); }
+    glm::vec3 velocity(int body) const { return glm::vec3(velocityX[body], velocityY[body], velocityZ[body]); }
+    // Between the positions before and after the last step, for rendering between steps
+    glm::vec3 positionAt(int body, float alpha) const { return glm::mix(glm::vec3(previousX[body], previousY[body], previousZ[body]), position(body), alpha); }
+
+    int nodeCount() const { return static_cast<int>(nodes.size()); }
+    // Seconds the last step spent building the tree and evaluating forces
+    double buildSeconds() const { return lastBuildSeconds; }
+    double forceSeconds() const { return lastForceSeconds; }
+
+private:
+    // A subtree below the top levels, built by its own task
+    struct Subtree {
+        int node;               // Its root in nodes
+        int begin, end;
+        int level;
+        int offset = 0;         // Added to its other nodes' indices when appended to nodes
+    };
+
+    void buildTree(JobSystem& jobs);
+    void sortByMortonCode(JobSystem& jobs);
+    void buildNode(std::vector<GravityNode>& out, int index, int begin, int end, int level, std::vector<Subtree>* deferred) const;
+    void computeAccelerations(JobSystem& jobs);
+
+    // Bodies
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> velocityX, velocityY, velocityZ;
+    std::vector<float> accelerationX, accelerationY, accelerationZ;
+    std::vector<float> previousX, previousY, previousZ;
+    std::vector<float> masses;
+    bool accelerationsValid = false;
+
+    // Tree, rebuilt every step
+    glm::vec3 rootMin = glm::vec3(0);
+    float rootSize = 0.0f;
+    std::vector<uint32_t> codes;                // Morton codes in sorted order
+    std::vector<uint32_t> order;                // Body at each sorted position
+    std::vector<uint32_t> scratchCodes, scratchOrder;
+    std::vector<uint32_t> digitCounts;          // Radix histograms, per chunk
+    std::vector<glm::vec4> sortedBodies;        // Position and mass in sorted order
+    std::vector<GravityNode> nodes;
+    std::vector<Subtree> subtrees;
+    std::vector<int> leaves;
+    std::vector<std::vector<GravityNode>> subtreeNodes;
+    std::vector<glm::vec3> chunkBounds;         // Min and max of each chunk
+    double lastBuildSeconds = 0.0;
+    double lastForceSeconds = 0.0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include "Color.h"
+
+class JobSystem;
+
+// Linear float color target for HDR mode. Shaders write into it without any
+// clamping and resolveHdr() turns it into packed ARGB for presentation.
+// Channels are stored as separate planes so the resolve can load whole lanes.
+struct HdrBuffer {
+    int width = 0;
+    int height = 0;
+    std::vector<float> red;
+    std::vector<float> green;
+    std::vector<float> blue;
+
+    HdrBuffer(int width, int height)
+        : width(width), height(height), red(width * height), green(width * height), blue(width * height) {}
+
+    void clear() {
+        std::fill(red.begin(), red.end(), 0.0f);
+        std::fill(green.begin(), green.end(), 0.0f);
+        std::fill(blue.begin(), blue.end(), 0.0f);
+    }
+
+    // Shaders author colors on the 0-255 display scale, stored squared as linear light
+    void write(int x, int y, const ColorF& color) {
+        const float inv255 = 1.0f / 255.0f;
+        int index = y * width + x;
+        float r = color.red * inv255;
+        float g = color.green * inv255;
+        float b = color.blue * inv255;
+        red[index] = r * r;
+        green[index] = g * g;
+        blue[index] = b * b;
+    }
+};
+
+struct ToneMapSettings {
+    float exposure = 1.0f;
+    float whitePoint = 4.0f;    // Linear value that maps to full white
+};
+
+// Exposure, extended Reinhard and gamma 2 (sqrt) for rows [yBegin, yEnd).
+// Row y of the buffer goes to output + y * outputStride.
+void resolveHdrRows(const HdrBuffer& hdr, const ToneMapSettings& settings, Uint32* output, int outputStride, int yBegin, int yEnd);
+
+// resolveHdrRows() over the whole buffer, split into row bands on the job system
+void resolveHdr(const HdrBuffer& hdr, const ToneMapSettings& settings, Uint32* output, int outputStride, JobSystem& jobs);
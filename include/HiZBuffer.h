@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Pixels per side of a level 0 texel, one fragment block
+const int HIZ_TILE = 8;
+
+// Conservative depth pyramid of the screen for occlusion tests before vertex shading.
+// A level 0 texel holds a view depth every pixel of its tile is certainly covered at
+// or nearer, each level above the farthest of the 2x2 texels under it, so one texel
+// answers for everything it spans. The rasterizer only knows depth after the vertices
+// are shaded, so the pyramid is filled up front from occluders of known shape.
+// Screen coordinates are those of the viewport matrix, row 0 at the bottom.
+class HiZBuffer {
+public:
+    HiZBuffer(int width, int height);
+
+    // Nothing covered
+    void clear();
+
+    // A sphere the frame draws opaque, given in world space
+    void addSphere(const glm::vec3& center, float radius, const glm::mat4& view, const glm::mat4& projection, const glm::mat4& viewport);
+
+    // Builds the levels above 0, after the last occluder was added
+    void buildPyramid();
+
+    // Whether anything in the pixel rectangle at least depth away is hidden
+    bool occluded(const glm::vec2& min, const glm::vec2& max, float depth) const;
+
+    int occluderCount() const { return occluders; }
+
+private:
+    struct Level {
+        int width;
+        int height;
+        std::vector<float> depths;
+    };
+
+    int width;
+    int height;
+    int occluders = 0;
+    std::vector<Level> levels;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+const int MAX_JOB_WORKERS = 64;
+
+// Counters of one worker thread since the last JobSystem::takeCounters()
+struct WorkerCounters {
+    uint64_t tasks = 0;             // Tasks run
+    uint64_t steals = 0;            // Tasks taken from another worker's deque
+    uint64_t busyNanoseconds = 0;   // Time spent inside tasks
+};
+
+class Job;
+using JobHandle = std::shared_ptr<Job>;
+
+// Work-stealing task scheduler shared by every stage of the renderer. Each worker owns
+// a deque: it pushes and pops at the back and idle workers steal from the front.
+// Submitted jobs go through a shared queue that only idle workers take from. Any
+// thread that waits on work runs its own and stolen parallelFor chunks meanwhile, so
+// waits can nest.
+class JobSystem {
+public:
+    explicit JobSystem(unsigned threadCount = std::thread::hardware_concurrency());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Calls body(begin, end) over chunks of [0, count) and returns once all of them ran.
+    // grain is the chunk size, 0 splits into a few chunks per worker. body is only
+    // referenced, so nothing is allocated however much it captures.
+    template <typename Body>
+    void parallelFor(int count, const Body& body, int grain = 0) {
+        parallelForRange(count, [](const void* body, int begin, int end) { (*static_cast<const Body*>(body))(begin, end); }, &body, grain);
+    }
+
+    // Runs task once every dependency has finished
+    JobHandle submit(std::function<void()> task, std::initializer_list<JobHandle> dependencies = {});
+    // The same, reusing job instead of allocating one, so a job submitted again and again
+    // stops touching the heap. job is null the first time; a job still running is
+    // waited for.
+    void submit(JobHandle& job, std::function<void()> task, std::initializer_list<JobHandle> dependencies = {});
+    void wait(const JobHandle& job);
+    bool isDone(const JobHandle& job) const;
+
+    // Frame-level wait for everything submitted so far, including tasks submitted meanwhile
+    void waitIdle();
+
+    unsigned threadCount() const { return static_cast<unsigned>(workers.size()); }
+
+    // Index of the calling thread in this pool, -1 for any other thread
+    int workerIndex() const;
+
+    // Copies the per-worker counters into out (threadCount() entries), resets them and
+    // returns the nanoseconds since the previous call, for utilisation
+    uint64_t takeCounters(WorkerCounters* out);
+
+    // Heap allocations made by the worker threads so far, see AllocationCounter.h
+    uint64_t heapAllocationCount() const;
+
+    // Queue entry, run(context, index)
+    struct Task {
+        void (*run)(void* context, int index) = nullptr;
+        void* context = nullptr;
+        int index = 0;
+    };
+
+private:
+    using RangeFunction = void (*)(const void* body, int begin, int end);
+    void parallelForRange(int count, RangeFunction run, const void* body, int grain);
+
+    // Fixed-capacity ring buffer, so queueing a task never allocates
+    struct TaskQueue {
+        static const int CAPACITY = 1024;
+        std::mutex mutex;
+        Task tasks[CAPACITY];
+        int head = 0;
+        int size = 0;
+
+        bool pushBack(const Task& task);
+        bool popBack(Task& task);
+        bool popFront(Task& task);
+    };
+
+    struct alignas(64) Worker {
+        TaskQueue queue;
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> busyNanoseconds{0};
+        std::atomic<const std::atomic<uint64_t>*> heapAllocations{nullptr};  // The thread's counter, once it started
+    };
+
+    void workerLoop(int index);
+    void enqueue(const Task& task, bool job);
+    // Runs one queued task if there is any, takeJobs from the workers' idle loop only
+    bool tryRunTask(bool takeJobs);
+    void execute(const Task& task, int worker);
+    void schedule(const JobHandle& job);
+
+    static void runJob(void* context, int index);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    TaskQueue injected;                         // Submitted jobs, from any thread
+    std::atomic<unsigned> nextWorker{0};        // Round robin for chunks queued from outside
+    std::atomic<int> queuedTasks{0};
+    std::atomic<int> sleepingWorkers{0};
+    std::atomic<int> outstandingTasks{0};       // Queued, running or waiting on dependencies
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{false};
+    std::atomic<int64_t> countersStart{0};
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <vector>
+#include "JobSystem.h"
+
+// Bump allocator for data that lives until the next reset(). Deallocation is a no-op.
+// Memory comes in chunks that are kept across resets; when a frame needed more than
+// one, reset() merges them into a single chunk, so after warm-up a frame allocates
+// nothing from the heap. Usable as a memory_resource for std::pmr containers.
+class LinearAllocator : public std::pmr::memory_resource {
+public:
+    explicit LinearAllocator(size_t initialBytes = 64 * 1024);
+
+    LinearAllocator(const LinearAllocator&) = delete;
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+    // Uninitialised storage for count objects of T, T must be trivially destructible
+    // or not need its destructor called
+    template <typename T>
+    std::span<T> allocateArray(size_t count) {
+        return {static_cast<T*>(allocate(count * sizeof(T), alignof(T))), count};
+    }
+
+    // Forgets every allocation, the memory is reused by the next ones
+    void reset();
+
+    size_t bytesUsed() const { return used; }
+    size_t capacity() const;
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+private:
+    struct Chunk {
+        std::unique_ptr<std::byte[]> memory;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks;
+    size_t current = 0;     // Chunk being bumped
+    size_t offset = 0;      // Next free byte in it
+    size_t used = 0;        // Bytes handed out since the last reset, for stats
+};
+
+// One LinearAllocator per job worker plus one for the thread that owns the frame,
+// so jobs allocate transient frame data without locking. Reset once per frame,
+// when nothing allocated from it is still in use.
+class FrameArena {
+public:
+    explicit FrameArena(JobSystem& jobs);
+
+    // Allocator of the calling thread
+    LinearAllocator& local();
+
+    void reset();
+    size_t bytesUsed() const;
+
+private:
+    JobSystem& jobs;
+    std::vector<std::unique_ptr<LinearAllocator>> allocators;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "VisibilityBuffer.h"
+
+struct DrawCall;
+struct FrameStats;
+
+using RasterFunction = void (*)(const DrawCall& draw, uint32_t drawId, int minY, int maxY, FrameStats& stats);
+using ResolveFunction = void (*)(const DrawCall& draw, int tileX, int tileY, uint64_t mask, const VisibilityId* ids, FrameStats& stats);
+
+// A fragment shader compiled into the forward and deferred stages of a draw, so the
+// shader is only picked at runtime once per draw. Built by material<Shader>() in main.cpp.
+struct Material {
+    RasterFunction rasterize = nullptr;
+    ResolveFunction resolve = nullptr;
+};
+
+// One copy of an instanced mesh
+struct Instance {
+    glm::mat4 model;
+    Material material;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Meshlet.h"
+#include "VertexQuantization.h"
+
+// Non-owning view of a mesh
+struct MeshView {
+    std::span<const glm::vec3> vertices;    // Position, normal pairs, three vertices per triangle
+    std::span<const Meshlet> meshlets;      // Covering every triangle in order
+    const QuantizedVertices* quantized = nullptr;  // Replaces vertices if set
+
+    // Position, normal pairs of a meshlet's vertices. Quantized ones are decoded into
+    // scratch, which holds 2 * 3 * MESHLET_MAX_TRIANGLES.
+    const glm::vec3* meshletVertices(const Meshlet& meshlet, glm::vec3* scratch) const {
+        if (!quantized)
+            return &vertices[6 * meshlet.firstTriangle];
+        quantized->decode(3 * meshlet.firstTriangle, 3 * meshlet.triangleCount, scratch);
+        return scratch;
+    }
+};
+
+// Vertex buffer shared by every model and draw that uses it, never modified once
+// registered. Its triangles are ordered into meshlets when it is registered, and if
+// the registry compresses vertices only the quantized copy is kept.
+struct Mesh {
+    std::string name;
+    std::vector<glm::vec3> vertexBufferObject;  // Empty if quantized
+    QuantizedVertices quantized;
+    std::vector<Meshlet> meshlets;
+    float boundingRadius = 0.0f;    // Of a sphere around the origin that holds every vertex
+
+    MeshView view() const { return MeshView{vertexBufferObject, meshlets, quantized.empty() ? nullptr : &quantized}; }
+    size_t bytes() const { return vertexBufferObject.size() * sizeof(glm::vec3) + quantized.bytes() + meshlets.size() * sizeof(Meshlet); }
+    // What the vertices take as floats
+    size_t uncompressedBytes() const { return (quantized.empty() ? vertexBufferObject.size() : 2 * quantized.vertexCount()) * sizeof(glm::vec3) + meshlets.size() * sizeof(Meshlet); }
+};
+
+using MeshHandle = std::shared_ptr<const Mesh>;
+
+struct MeshRegistryStats {
+    size_t meshes = 0;
+    size_t handles = 0;         // Live handles across all meshes
+    size_t bytes = 0;           // Vertex data actually held
+    size_t uncompressedBytes = 0;   // The same with float vertices
+    size_t quantizedMeshes = 0;
+    size_t copiedBytes = 0;     // What it would take if every handle owned a copy
+};
+
+// Builds each mesh once and hands out shared handles to it. Only weak references are
+// kept, a mesh is freed with its last handle. Safe to call from jobs.
+class MeshRegistry {
+public:
+    explicit MeshRegistry(VertexCompression compression = {}) : compression(compression) {}
+
+    // The mesh of an .obj file, loaded on first use. Null if the file can't be read.
+    MeshHandle load(const std::string& path);
+
+    // Registers a vertex buffer built in code, or returns the mesh already registered as name
+    MeshHandle add(const std::string& name, std::vector<glm::vec3> vertexBufferObject);
+
+    // Null if name isn't loaded
+    MeshHandle find(const std::string& name) const;
+
+    MeshRegistryStats stats() const;
+
+private:
+    const VertexCompression compression;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<const Mesh>> meshes;
+};
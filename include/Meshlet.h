@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Frustum.h"
+#include "Uniform.h"
+
+class HiZBuffer;
+
+// Triangles per meshlet. Its 192 vertices are also the tile instanced draws shade at once.
+const int MESHLET_MAX_TRIANGLES = 64;
+
+// Run of consecutive triangles of a mesh that lie close together and face roughly the
+// same way, bounded in model space so it can be rejected as a whole before any of its
+// vertices are shaded
+struct Meshlet {
+    glm::vec3 center = glm::vec3(0);
+    float radius = 0.0f;
+    glm::vec3 coneAxis = glm::vec3(0);  // Average vertex normal
+    float coneCutoff = -1.0f;           // Cosine of the widest angle from coneAxis to a normal, 0 or less never culls
+    uint32_t firstTriangle = 0;
+    uint32_t triangleCount = 0;
+};
+
+// Splits a vertex buffer (position, normal pairs, three vertices per triangle) into
+// meshlets, reordering its triangles so every meshlet's are contiguous
+std::vector<Meshlet> buildMeshlets(std::vector<glm::vec3>& vertexBufferObject);
+
+// Meshlets tested and why the rejected ones were
+struct MeshletStats {
+    int tested = 0;
+    int outsideFrustum = 0;
+    int backfacing = 0;
+    int occluded = 0;
+
+    void add(const MeshletStats& other) {
+        tested += other.tested;
+        outsideFrustum += other.outsideFrustum;
+        backfacing += other.backfacing;
+        occluded += other.occluded;
+    }
+};
+
+// Meshlet tests of one draw, with everything it needs moved into model space once:
+// the frustum, the normal cone against the rasterizer's per-pixel view culling
+// (see forEachTrianglePixel()) and the screen rectangle against a HiZBuffer.
+// The model matrix may rotate, translate and scale uniformly.
+class MeshletCuller {
+public:
+    MeshletCuller(const Uniforms& uniforms, const glm::vec3& viewDirection, const HiZBuffer* hiZ);
+
+    bool visible(const Meshlet& meshlet, MeshletStats& stats) const;
+
+private:
+    Frustum frustum;
+    glm::vec3 modelViewDirection;
+    glm::mat4 modelView;
+    float modelScale;
+    glm::vec2 pixelsPerUnit;            // Screen offset of a unit offset at depth 1
+    glm::vec2 screenCenter;
+    const HiZBuffer* hiZ;
+};
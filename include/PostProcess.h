@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "HdrBuffer.h"
+#include "FrameStats.h"
+
+class JobSystem;
+
+// Float image buffers reused across frames. acquire() only allocates when no free
+// buffer has the requested size, so a chain that runs every frame stops allocating
+// after the first one.
+class BufferPool {
+public:
+    HdrBuffer* acquire(int width, int height);
+    void release(HdrBuffer* buffer);
+
+    int allocations() const { return allocationCount; }
+
+private:
+    std::vector<std::unique_ptr<HdrBuffer>> buffers;
+    std::vector<HdrBuffer*> freeBuffers;
+    int allocationCount = 0;
+};
+
+// What the post-processing passes read and write. Scene color is either the linear
+// HDR target or, outside HDR mode, the packed ARGB framebuffer.
+struct PostTarget {
+    HdrBuffer* hdr = nullptr;
+    Uint32* ldr = nullptr;
+    int ldrStride = 0;
+    const HdrBuffer* emissive = nullptr;    // Linear color of emissive surfaces, black elsewhere
+    int width = 0;
+    int height = 0;
+};
+
+// A full-screen pass. Passes split their work into row bands on the job system
+// and take any scratch images from the buffer pool.
+class PostPass {
+public:
+    virtual ~PostPass() = default;
+    virtual const char* name() const = 0;
+    virtual void run(const PostTarget& target, BufferPool& buffers, JobSystem& jobs) = 0;
+};
+
+// Bilinear upsampling taps for each column of the full-size image
+struct BloomColumns {
+    std::vector<int> left;
+    std::vector<int> right;
+    std::vector<float> weight;
+    int bloomWidth = 0;
+};
+
+// Blurs a downsampled copy of the emissive buffer with a separable gaussian and
+// adds it back onto the scene color
+class BloomPass : public PostPass {
+public:
+    BloomPass(int downsample = 4, int radius = 6, float strength = 0.6f);
+
+    const char* name() const override { return "Bloom"; }
+    void run(const PostTarget& target, BufferPool& buffers, JobSystem& jobs) override;
+
+    int downsample;
+    float strength;
+
+private:
+    std::vector<float> weights;     // Gaussian taps from -radius to radius
+    BloomColumns columns;
+    std::vector<char> litRows;      // Bloom rows with any light in them
+};
+
+// Runs its passes in order after the main pass and records how long each took
+class PostChain {
+public:
+    void add(std::unique_ptr<PostPass> pass) { passes.push_back(std::move(pass)); }
+    void run(const PostTarget& target, JobSystem& jobs, FrameStats& stats);
+
+    const BufferPool& bufferPool() const { return buffers; }
+
+private:
+    std::vector<std::unique_ptr<PostPass>> passes;
+    BufferPool buffers;
+};
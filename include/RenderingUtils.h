@@ -4,24 +4,39 @@
 #include <glm/glm.hpp>
 #include "glm/gtc/matrix_transform.hpp" // glm::lookAt()
 #include <vector>
+#include <span>
+#include <memory_resource>
 #include "Color.h"
 #include "Vertex.h"
 #include "Face.h"
 #include "Fragment.h"
+#include "FragmentBlock.h"
 #include "Camera.h"
 #include "globals.h"
 
+// Light position used for the per-pixel intensity
+extern glm::vec3 L;
+
+// Three consecutive transformed vertices of a draw
+struct Triangle {
+    Vertex vertices[3];
+
+    const Vertex& operator[](int i) const { return vertices[i]; }
+    Vertex& operator[](int i) { return vertices[i]; }
+};
+
 // Render to window
 void drawPoint(SDL_Renderer* renderer, float x_position, float y_position, const Color& color = Color(255, 255, 255));
 // Fragment generating
-std::vector<Fragment> drawLine(const glm::vec3& start, const glm::vec3& end, const Color& color = Color(255, 255, 255));
-std::vector<Fragment> drawTriangle(const glm::vec3& pointA, const glm::vec3& pointB, const glm::vec3& pointC, const Color& color = Color(255, 255, 255));
-std::vector<Fragment> drawTriangle(const std::vector<Vertex>& triangle, const Color& color = Color(255, 255, 255));
-std::vector<Fragment> getTriangleFragments(Vertex a, Vertex b, Vertex c, const int SCREEN_WIDTH, const int SCREEN_HEIGHT, const Camera& camera);
+// The fragment lists come from memory, pass a frame arena (see LinearAllocator) for transient ones
+std::pmr::vector<Fragment> drawLine(const glm::vec3& start, const glm::vec3& end, const Color& color = Color(255, 255, 255), std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+std::pmr::vector<Fragment> drawTriangle(const glm::vec3& pointA, const glm::vec3& pointB, const glm::vec3& pointC, const Color& color = Color(255, 255, 255), std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+std::pmr::vector<Fragment> drawTriangle(const Triangle& triangle, const Color& color = Color(255, 255, 255), std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+std::pmr::vector<Fragment> getTriangleFragments(Vertex a, Vertex b, Vertex c, const int SCREEN_WIDTH, const int SCREEN_HEIGHT, const Camera& camera, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
 // Rendering pipeline
 std::vector<glm::vec3> setupVertexBufferObject(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, const std::vector<Face>& faces);
-std::vector<std::vector<Vertex>> primitiveAssembly (const std::vector<Vertex>& transformedVertices);
-std::vector<Fragment> rasterize(const std::vector<std::vector<glm::vec3>>& assembledVertices);
+std::pmr::vector<Triangle> primitiveAssembly(std::span<const Vertex> transformedVertices, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+std::pmr::vector<Fragment> rasterize(std::span<const Triangle> triangles, std::pmr::memory_resource* memory = std::pmr::get_default_resource());
 // Transformation matrixes
 glm::mat4 createModelMatrix(const glm::vec3& scaleVector = glm::vec3(1, 1, 1), const glm::vec3& translationVector = glm::vec3(0, 0, 0), const float rotationAngleRadians = 0.0f, const glm::vec3& rotationAxis = glm::vec3(0, 1, 0));
 glm::mat4 createViewMatrix(Camera camera);
@@ -34,4 +49,130 @@ bool bBoxInsideScreen(int minX, int minY, int maxX, int maxY, int SCREEN_WIDTH,
 glm::vec3 barycentricCoordinates(const glm::vec3& P, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C);
 bool isInsideTriangle(const glm::vec3& barycentricCoordinates);
 glm::vec3 findTriangleCentroid(Vertex a, Vertex b, Vertex c);
-glm::vec3 calculateTriangleNormal(glm::vec3 A,glm::vec3 B, glm::vec3 C);
\ No newline at end of file
+glm::vec3 calculateTriangleNormal(glm::vec3 A,glm::vec3 B, glm::vec3 C);
+bool triangleScreenBounds(const Vertex& a, const Vertex& b, const Vertex& c, const int SCREEN_WIDTH, const int SCREEN_HEIGHT, int& minX, int& minY, int& maxX, int& maxY);
+
+// Interpolated, normalized normal of a pixel inside the triangle
+inline glm::vec3 interpolateNormal(const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec3& barCoords) {
+    return glm::normalize(a.normal * barCoords.x + b.normal * barCoords.y + c.normal * barCoords.z);
+}
+
+// Calls pixel(x, y, barCoords, normal) for every pixel of [startX, endX] x [startY, endY]
+// that is inside the triangle and survives view culling
+template <typename PixelFunction>
+void forEachTrianglePixel(const Vertex& a, const Vertex& b, const Vertex& c, const Camera& camera, int startX, int startY, int endX, int endY, PixelFunction&& pixel) {
+    for (int y = startY; y <= endY; y++) {
+        for (int x = startX; x <= endX; x++) {
+            glm::vec3 P(x, y, 0);
+            glm::vec3 barCoords = barycentricCoordinates(P, a.position, b.position, c.position);
+            if (!isInsideTriangle(barCoords))
+            continue;
+
+            // Interpolate normal
+            glm::vec3 normal = interpolateNormal(a, b, c, barCoords);
+
+            // View culling
+            float epsilon = 0.2f;
+            bool inView = glm::dot(camera.viewDirection, normal) < epsilon;
+            if (!inView)
+            continue;
+
+            pixel(x, y, barCoords, normal);
+        }
+    }
+}
+
+// Interpolated z of a pixel inside the triangle
+inline float interpolateZ(const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec3& barCoords) {
+    return a.position.z * barCoords.x + b.position.z * barCoords.y + c.position.z * barCoords.z;
+}
+
+// Fills the interpolants in the Interpolants mask for one lane of a block
+template <unsigned Interpolants>
+void interpolateLane(FragmentBlock<Interpolants>& block, int lane, const Vertex& a, const Vertex& b, const Vertex& c, const glm::vec3& barCoords, const glm::vec3& normal) {
+    float u = barCoords.x;
+    float v = barCoords.y;
+    float w = barCoords.z;
+
+    if constexpr ((Interpolants & INTERPOLATE_Z) != 0) {
+        block.z[lane] = interpolateZ(a, b, c, barCoords);
+    }
+
+    if constexpr ((Interpolants & INTERPOLATE_INTENSITY) != 0) {
+        // Interpolate world position
+        glm::vec3 worldPosition = a.position * u + b.position * v + c.position * w;
+
+        // Calculate intensity
+        glm::vec3 lightDirection = glm::normalize(L - worldPosition);
+        float intensity = glm::dot(normal, lightDirection);
+        block.intensity[lane] = (intensity < 0) ? std::abs(intensity) : 0.0f;    // Truncate the value for normals facing opposite of L
+    }
+
+    if constexpr ((Interpolants & INTERPOLATE_NORMAL) != 0) {
+        block.normalX[lane] = normal.x;
+        block.normalY[lane] = normal.y;
+        block.normalZ[lane] = normal.z;
+    }
+
+    if constexpr ((Interpolants & INTERPOLATE_ORIGINAL_POSITION) != 0) {
+        // Interpolate original position
+        glm::vec3 originalPosition = a.originalPos * u + b.originalPos * v + c.originalPos * w;
+        block.originalX[lane] = originalPosition.x;
+        block.originalY[lane] = originalPosition.y;
+        block.originalZ[lane] = originalPosition.z;
+    }
+}
+
+// Narrows the screen bounds of a triangle to rows [minRow, maxRow]
+inline bool clipBoundsToRows(int& minY, int& maxY, int minRow, int maxRow) {
+    minY = std::max(minY, minRow);
+    maxY = std::min(maxY, maxRow);
+    return minY <= maxY;
+}
+
+// Block rasterization, emitBlock(block) is called once per tile with at least one covered pixel.
+// Interpolants is a mask of the Interpolant flags the shader reads, the others are never computed.
+// Only rows [minRow, maxRow] are rasterized; minRow must be on the block grid.
+template <unsigned Interpolants, typename EmitBlock>
+void rasterizeTriangleBlocks(const Vertex& a, const Vertex& b, const Vertex& c, const int SCREEN_WIDTH, const int SCREEN_HEIGHT, const Camera& camera, int minRow, int maxRow, FragmentBlock<Interpolants>& block, EmitBlock&& emitBlock) {
+    int minX, minY, maxX, maxY;
+    if (!triangleScreenBounds(a, b, c, SCREEN_WIDTH, SCREEN_HEIGHT, minX, minY, maxX, maxY) || !clipBoundsToRows(minY, maxY, minRow, maxRow))
+    return;
+
+    // Walk the bounding box in tiles aligned to the block grid
+    for (int tileY = minY - minY % BLOCK_SIZE; tileY <= maxY; tileY += BLOCK_SIZE) {
+        for (int tileX = minX - minX % BLOCK_SIZE; tileX <= maxX; tileX += BLOCK_SIZE) {
+            block.x = tileX;
+            block.y = tileY;
+            block.mask = 0;
+
+            int startX = std::max(tileX, minX);
+            int startY = std::max(tileY, minY);
+            int endX = std::min(tileX + BLOCK_SIZE - 1, maxX);
+            int endY = std::min(tileY + BLOCK_SIZE - 1, maxY);
+
+            forEachTrianglePixel(a, b, c, camera, startX, startY, endX, endY, [&](int x, int y, const glm::vec3& barCoords, const glm::vec3& normal) {
+                int lane = (y - tileY) * BLOCK_SIZE + (x - tileX);
+                block.mask |= uint64_t(1) << lane;
+                block.depth[lane] = quantizeDepth(interpolateZ(a, b, c, barCoords));
+                interpolateLane(block, lane, a, b, c, barCoords, normal);
+            });
+
+            if (block.mask != 0)
+            emitBlock(block);
+        }
+    }
+}
+
+// Visibility pass rasterization, visible(x, y, depth) is called for every covered pixel in
+// rows [minRow, maxRow] and nothing is interpolated beyond what the depth test needs
+template <typename VisibleFunction>
+void rasterizeTriangleVisibility(const Vertex& a, const Vertex& b, const Vertex& c, const int SCREEN_WIDTH, const int SCREEN_HEIGHT, const Camera& camera, int minRow, int maxRow, VisibleFunction&& visible) {
+    int minX, minY, maxX, maxY;
+    if (!triangleScreenBounds(a, b, c, SCREEN_WIDTH, SCREEN_HEIGHT, minX, minY, maxX, maxY) || !clipBoundsToRows(minY, maxY, minRow, maxRow))
+    return;
+
+    forEachTrianglePixel(a, b, c, camera, minX, minY, maxX, maxY, [&](int x, int y, const glm::vec3& barCoords, const glm::vec3&) {
+        visible(x, y, quantizeDepth(interpolateZ(a, b, c, barCoords)));
+    });
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Index of a node in a SceneGraph
+using SceneNode = int;
+const SceneNode NO_PARENT = -1;
+
+// Transform hierarchy stored as flat arrays, one entry per node. Nodes are added
+// parents first, so index order is a topological order and updateWorldTransforms()
+// is a single linear pass. Local transforms are translation * scale * rotation about
+// Y, like createModelMatrix(). Only nodes whose local transform changed, or whose
+// parent's world transform did, are recomputed.
+class SceneGraph {
+public:
+    // parent must already exist
+    SceneNode addNode(SceneNode parent, const glm::vec3& translation, const glm::vec3& scale = glm::vec3(1), float rotation = 0.0f);
+
+    // Setters only mark the node dirty if the value changed
+    void setTranslation(SceneNode node, const glm::vec3& translation);
+    void setScale(SceneNode node, const glm::vec3& scale);
+    void setRotation(SceneNode node, float rotation);
+
+    // Recomputes the world matrices of everything that changed, returns the number of
+    // nodes recomputed. Bounds are not kept here: culling uses BodyStore::bounds().
+    int updateWorldTransforms();
+
+    const glm::mat4& worldMatrix(SceneNode node) const { return worldMatrices[node]; }
+    SceneNode parent(SceneNode node) const { return parents[node]; }
+    int size() const { return static_cast<int>(parents.size()); }
+
+private:
+    // Local transforms
+    std::vector<glm::vec3> translations;
+    std::vector<glm::vec3> scales;
+    std::vector<float> rotations;
+    std::vector<SceneNode> parents;
+    std::vector<uint8_t> dirty;         // Local transform changed since the last update
+    std::vector<uint8_t> changed;       // World transform changed in the last update
+    // Cached results
+    std::vector<glm::mat4> worldMatrices;
+};
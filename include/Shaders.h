@@ -3,15 +3,79 @@
 #include <glm/glm.hpp>
 #include "Uniform.h"
 #include "Color.h"
-#include "Fragment.h"
+#include "FragmentBlock.h"
 #include "Vertex.h"
 #include "FastNoiseLite.h"
 
 Vertex vertexShader(const Vertex& vertex, const Uniforms& uniforms);
-Fragment stripedPlanetFragmentShader(const Fragment& fragment);
-Fragment earthPlanetFragmentShader(const Fragment& fragment);
-Fragment moonFragmentShader(const Fragment& fragment);
-Fragment starFragmentShader(const Fragment& fragment);
-Fragment redPlanetFragmentShader(const Fragment& fragment);
-Fragment testFragmentShader(const Fragment& fragment);
-Fragment shipFragmentShader(const Fragment& fragment);
\ No newline at end of file
+
+// The matrices vertexShader() needs, combined once per draw instead of per vertex
+struct VertexTransform {
+    glm::mat4 modelViewProjection;
+    glm::mat4 viewport;
+    glm::mat3 normalMatrix;
+
+    explicit VertexTransform(const Uniforms& uniforms)
+        : modelViewProjection(uniforms.projection * uniforms.view * uniforms.model),
+          viewport(uniforms.viewport),
+          normalMatrix(uniforms.model) {}
+};
+
+Vertex vertexShader(const Vertex& vertex, const VertexTransform& transform);
+
+// Fragment shaders are functor types so render<Shader>() can be instantiated per shader.
+// Each one writes an unclamped ColorF per lane of the block and lists the Interpolant
+// flags it reads, so the rasterizer skips everything else.
+// The noise shaders are defined in Shaders.cpp, their cost is in the noise itself.
+// Shaders that set emissive also feed their colors to the bloom pass.
+
+struct StripedPlanetFragmentShader {
+    static constexpr unsigned interpolants = INTERPOLATE_INTENSITY | INTERPOLATE_ORIGINAL_POSITION;
+    void operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const;
+};
+
+struct EarthPlanetFragmentShader {
+    static constexpr unsigned interpolants = INTERPOLATE_Z | INTERPOLATE_INTENSITY | INTERPOLATE_ORIGINAL_POSITION;
+    void operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const;
+};
+
+struct MoonFragmentShader {
+    static constexpr unsigned interpolants = INTERPOLATE_INTENSITY | INTERPOLATE_ORIGINAL_POSITION;
+    void operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const;
+};
+
+struct StarFragmentShader {
+    static constexpr unsigned interpolants = INTERPOLATE_ORIGINAL_POSITION;
+    static constexpr bool emissive = true;
+    void operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const;
+};
+
+struct RedPlanetFragmentShader {
+    static constexpr unsigned interpolants = INTERPOLATE_INTENSITY | INTERPOLATE_ORIGINAL_POSITION;
+    void operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const;
+};
+
+template <typename Shader>
+constexpr bool isEmissive = requires { requires Shader::emissive; };
+
+struct TestFragmentShader {
+    static constexpr unsigned interpolants = INTERPOLATE_INTENSITY;
+    void operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const {
+        ColorF fragmentColor = ColorF(220, 220, 220);
+
+        for (int i = 0; i < BLOCK_PIXELS; i++) {
+            colors[i] = fragmentColor * block.intensity[i];
+        }
+    }
+};
+
+struct ShipFragmentShader {
+    static constexpr unsigned interpolants = INTERPOLATE_INTENSITY;
+    void operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const {
+        ColorF fragmentColor = ColorF(255, 20, 20);
+
+        for (int i = 0; i < BLOCK_PIXELS; i++) {
+            colors[i] = fragmentColor * block.intensity[i];
+        }
+    }
+};
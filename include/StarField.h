@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+class JobSystem;
+class FrameArena;
+
+// Stars per task of generate() and project()
+const int STAR_CHUNK = 2048;
+// Largest radius of a star on screen in pixels, a star reaches at most this far into
+// the band above or below its own
+const float STAR_MAX_RADIUS = 2.5f;
+
+// A star on screen
+struct ProjectedStar {
+    float x;
+    float y;
+    float z;            // Screen depth, like a vertex after vertexShader()
+    float radius;       // Pixels, 0.5 or less covers the one pixel the star is in
+    float brightness;   // 0-255
+};
+
+// What StarField::project() left on screen, in the frame's arena. Each chunk of stars
+// has its projected stars ordered by the band of rows their center is in: band b of
+// chunk c is stars[c][bandStarts[c * (bandCount + 1) + b]] up to the next start.
+struct ProjectedStars {
+    int bandHeight = 0;
+    int bandCount = 0;
+    std::span<const ProjectedStar*> stars;
+    std::span<uint32_t> bandStarts;
+    int visible = 0;
+
+    std::span<const ProjectedStar> band(int chunk, int band) const {
+        const uint32_t* starts = &bandStarts[chunk * (bandCount + 1)];
+        return {stars[chunk] + starts[band], starts[band + 1] - starts[band]};
+    }
+};
+
+// Point stars at finite distance, stored as parallel arrays so they are transformed
+// eight at a time. Sized for millions: generation and projection both run in chunks
+// on the job system.
+class StarField {
+public:
+    // count stars spread evenly through the shell between two radii around the origin,
+    // most of them faint and small. The same seed gives the same field.
+    void generate(int count, float innerRadius, float outerRadius, uint64_t seed, JobSystem& jobs);
+
+    int size() const { return static_cast<int>(xs.size()); }
+
+    // Transforms every star to the screen of viewProjection and viewport, a screen
+    // space scale and translation like createViewportMatrix(). Stars behind the near
+    // plane or off the screen are dropped, the rest binned into bands of bandHeight
+    // rows, at least STAR_MAX_RADIUS.
+    ProjectedStars project(const glm::mat4& viewProjection, const glm::mat4& viewport, int width, int height, int bandHeight,
+        FrameArena& arena, JobSystem& jobs) const;
+
+private:
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> zs;
+    std::vector<float> radii;
+    std::vector<float> brightnesses;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+class JobSystem;
+
+// Texels per side of the tiles regionEmpty() checks
+const int SKYBOX_TILE = 16;
+
+// Star field baked once into a cube map of brightness, so the background of a frame
+// is one lookup per pixel of its view direction instead of a projection per star.
+// The stars are infinitely far away, only the camera's rotation moves them.
+class StarSkybox {
+public:
+    // stars are directions from the origin. pixelsPerTangent is the screen's pixels per
+    // unit of tan(angle off the view axis): texels are made no larger than pixels and
+    // each star a small blur about a pixel wide, so nearest lookups always light the
+    // pixel a star falls in.
+    void bake(std::span<const glm::vec3> stars, float pixelsPerTangent, JobSystem& jobs);
+
+    bool empty() const { return faceSize == 0; }
+    size_t bytes() const { return texels.size(); }
+
+    // Brightness 0-255 seen toward direction, which needn't be normalized
+    uint8_t sample(const glm::vec3& direction) const {
+        int face;
+        glm::vec2 texel = faceTexel(direction, face);
+        int column = std::min(static_cast<int>(texel.x), faceSize - 1);
+        int row = std::min(static_cast<int>(texel.y), faceSize - 1);
+        return texels[(static_cast<size_t>(face) * faceSize + row) * faceSize + column];
+    }
+
+    // Whether every direction between the four corners of a screen rectangle is dark,
+    // false whenever the rectangle straddles faces
+    bool regionEmpty(const glm::vec3 corners[4]) const;
+
+private:
+    // Face direction lands on and where on it, in texels from the face's corner
+    glm::vec2 faceTexel(const glm::vec3& direction, int& face) const {
+        float x = std::abs(direction.x);
+        float y = std::abs(direction.y);
+        float z = std::abs(direction.z);
+        float along, u, v;
+        if (x >= y && x >= z) {
+            face = direction.x < 0.0f ? 1 : 0;
+            along = x;
+            u = direction.y;
+            v = direction.z;
+        } else if (y >= z) {
+            face = direction.y < 0.0f ? 3 : 2;
+            along = y;
+            u = direction.z;
+            v = direction.x;
+        } else {
+            face = direction.z < 0.0f ? 5 : 4;
+            along = z;
+            u = direction.x;
+            v = direction.y;
+        }
+        float half = 0.5f * faceSize;
+        float scale = half / along;
+        return glm::vec2(u * scale + half, v * scale + half);
+    }
+
+    int faceSize = 0;
+    int tilesPerSide = 0;
+    // Six faces of faceSize^2 texels, +x -x +y -y +z -z. A face's u and v run along the
+    // next two axes after its own, in the order x, y, z.
+    std::vector<uint8_t> texels;
+    std::vector<uint8_t> litTiles;  // Per SKYBOX_TILE^2 texels of each face, whether any is lit
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// How MeshRegistry may compress the vertices it registers. Positions become 16-bit
+// offsets into the mesh's bounding box, normals octahedral codes of 16 or 32 bits.
+// A mesh whose compressed vertices would stray further than the bounds keeps floats.
+struct VertexCompression {
+    bool enabled = false;
+    int normalBits = 32;                // 16 or 32
+    float maxPositionError = 1e-4f;     // Fraction of the mesh's bounding radius
+    float maxNormalError = 0.02f;       // Radians
+};
+
+// Compressed copy of a vertex buffer (position, normal pairs), one entry per vertex
+struct QuantizedVertices {
+    glm::vec3 offset = glm::vec3(0);    // position = offset + scale * code
+    glm::vec3 scale = glm::vec3(0);
+    int normalBits = 32;
+    std::vector<uint16_t> positions;    // x, y, z per vertex
+    std::vector<uint16_t> normals16;    // Used when normalBits is 16
+    std::vector<uint32_t> normals32;    // Used when normalBits is 32
+    float positionError = 0.0f;         // Largest distance of a decoded position from its original
+    float normalError = 0.0f;           // Largest angle of a decoded normal from its original
+
+    bool empty() const { return positions.empty(); }
+    size_t vertexCount() const { return positions.size() / 3; }
+    size_t bytes() const { return positions.size() * sizeof(uint16_t) + normals16.size() * sizeof(uint16_t) + normals32.size() * sizeof(uint32_t); }
+
+    // Writes count vertices from first as position, normal pairs. Normals come out
+    // with the right direction but not unit length, vertexShader() normalizes them.
+    void decode(uint32_t first, uint32_t count, glm::vec3* out) const;
+};
+
+// Compresses a vertex buffer and measures the error it introduced
+QuantizedVertices quantizeVertices(const std::vector<glm::vec3>& vertexBufferObject, int normalBits);
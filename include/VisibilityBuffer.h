@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+// Visibility buffer entry: draw id in the top 8 bits, triangle id in the low 24
+using VisibilityId = uint32_t;
+
+const int VISIBILITY_TRIANGLE_BITS = 24;
+const uint32_t VISIBILITY_MAX_DRAWS = 255;
+const uint32_t VISIBILITY_MAX_TRIANGLES = 1u << VISIBILITY_TRIANGLE_BITS;
+const VisibilityId VISIBILITY_EMPTY = 0xFFFFFFFFu;  // Draw id 255 is never handed out
+
+inline VisibilityId packVisibilityId(uint32_t drawId, uint32_t triangleId) {
+    return (drawId << VISIBILITY_TRIANGLE_BITS) | triangleId;
+}
+
+inline uint32_t visibilityDrawId(VisibilityId id) {
+    return id >> VISIBILITY_TRIANGLE_BITS;
+}
+
+inline uint32_t visibilityTriangleId(VisibilityId id) {
+    return id & (VISIBILITY_MAX_TRIANGLES - 1);
+}
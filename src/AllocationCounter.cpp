@@ -0,0 +1,72 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Per thread, so a count leaves out threads the work being measured doesn't run on.
+// Atomic only so other threads can read it, each is written by its own thread alone.
+static thread_local std::atomic<uint64_t> allocations{0};
+
+static void countAllocation() {
+    allocations.store(allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+uint64_t heapAllocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+const std::atomic<uint64_t>* threadHeapAllocationCounter() {
+    return &allocations;
+}
+
+// The nothrow and array forms of operator new forward to these by default
+
+void* operator new(std::size_t size) {
+    countAllocation();
+    if (void* memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    countAllocation();
+    std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    void* memory = _aligned_malloc(size ? size : 1, align);
+#else
+    // aligned_alloc wants a multiple of the alignment
+    std::size_t rounded = (size + align - 1) / align * align;
+    void* memory = std::aligned_alloc(align, rounded ? rounded : align);
+#endif
+    if (memory)
+        return memory;
+    throw std::bad_alloc();
+}
+
+static void freeAligned(void* memory) {
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    freeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    freeAligned(memory);
+}
@@ -0,0 +1,60 @@
+#include "AssetLoader.h"
+
+AssetLoader::AssetLoader(JobSystem& jobs) : jobs(jobs), start(std::chrono::steady_clock::now()) {}
+
+AssetLoader::~AssetLoader() {
+    waitAll();
+}
+
+AssetId AssetLoader::load(const std::string& name, bool required, std::function<bool()> task) {
+    // The asset is heap allocated so the job's pointer survives assets growing
+    assets.push_back(std::make_unique<Asset>(Asset{name, required}));
+    Asset* asset = assets.back().get();
+    asset->job = jobs.submit([this, asset, task = std::move(task)] {
+        asset->succeeded = task();
+        asset->milliseconds = elapsedMilliseconds();
+    });
+    return static_cast<AssetId>(assets.size() - 1);
+}
+
+bool AssetLoader::isDone(AssetId asset) const {
+    return jobs.isDone(assets[asset]->job);
+}
+
+bool AssetLoader::isReady(AssetId asset) const {
+    return isDone(asset) && assets[asset]->succeeded;
+}
+
+bool AssetLoader::requiredReady() const {
+    for (AssetId asset = 0; asset < count(); asset++) {
+        if (assets[asset]->required && !isReady(asset))
+            return false;
+    }
+    return true;
+}
+
+bool AssetLoader::failed() const {
+    for (AssetId asset = 0; asset < count(); asset++) {
+        if (assets[asset]->required && isDone(asset) && !assets[asset]->succeeded)
+            return true;
+    }
+    return false;
+}
+
+int AssetLoader::doneCount() const {
+    int done = 0;
+    for (AssetId asset = 0; asset < count(); asset++) {
+        done += isDone(asset) ? 1 : 0;
+    }
+    return done;
+}
+
+double AssetLoader::elapsedMilliseconds() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void AssetLoader::waitAll() {
+    for (const std::unique_ptr<Asset>& asset : assets) {
+        jobs.wait(asset->job);
+    }
+}
@@ -0,0 +1,240 @@
+#include "BodyStore.h"
+#include "JobSystem.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define BODY_USE_SSE2
+#endif
+
+// Bodies per task of update() and resolve()
+const int BODY_CHUNK = 4096;
+
+const double TWO_PI = 2.0 * 3.14159265358979323846;
+const float PI_F = 3.14159265f;
+const float HALF_PI_F = 1.57079633f;
+
+// Taylor series of sin and cos, accurate to float precision on [-pi/2, pi/2]
+const float SIN_3 = -1.0f / 6.0f;
+const float SIN_5 = 1.0f / 120.0f;
+const float SIN_7 = -1.0f / 5040.0f;
+const float SIN_9 = 1.0f / 362880.0f;
+const float SIN_11 = -1.0f / 39916800.0f;
+const float COS_2 = -1.0f / 2.0f;
+const float COS_4 = 1.0f / 24.0f;
+const float COS_6 = -1.0f / 720.0f;
+const float COS_8 = 1.0f / 40320.0f;
+const float COS_10 = -1.0f / 3628800.0f;
+const float COS_12 = 1.0f / 479001600.0f;
+
+// speed * time + phase wrapped to [-pi, pi]
+static inline float wrapAngle(float speed, float phase, double time) {
+    double turns = (static_cast<double>(speed) * time + phase) / TWO_PI;
+    // Rounds by truncation, which is a single instruction where floor() may be a libm call
+    turns -= static_cast<double>(static_cast<int64_t>(turns + (turns < 0.0 ? -0.5 : 0.5)));
+    return static_cast<float>(turns * TWO_PI);
+}
+
+// x in [-pi, pi]. Angles past pi/2 are reflected into range, which flips the cosine.
+static inline void sinCos(float x, float& s, float& c) {
+    float cosSign = 1.0f;
+    if (x > HALF_PI_F) {
+        x = PI_F - x;
+        cosSign = -1.0f;
+    } else if (x < -HALF_PI_F) {
+        x = -PI_F - x;
+        cosSign = -1.0f;
+    }
+    float x2 = x * x;
+    s = x * (1.0f + x2 * (SIN_3 + x2 * (SIN_5 + x2 * (SIN_7 + x2 * (SIN_9 + x2 * SIN_11)))));
+    c = cosSign * (1.0f + x2 * (COS_2 + x2 * (COS_4 + x2 * (COS_6 + x2 * (COS_8 + x2 * (COS_10 + x2 * COS_12))))));
+}
+
+#if defined(__AVX2__)
+// Eight angles at once, the wrap in two halves of four doubles
+static inline __m256 wrapAngles(const float* speed, const float* phase, __m256d time) {
+    const __m256d invTurn = _mm256_set1_pd(1.0 / TWO_PI);
+    __m128 halves[2];
+    for (int h = 0; h < 2; h++) {
+        __m256d angle = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(speed + 4 * h)), time);
+        if (phase)
+            angle = _mm256_add_pd(angle, _mm256_cvtps_pd(_mm_loadu_ps(phase + 4 * h)));
+        __m256d turns = _mm256_mul_pd(angle, invTurn);
+        turns = _mm256_sub_pd(turns, _mm256_round_pd(turns, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+        halves[h] = _mm256_cvtpd_ps(_mm256_mul_pd(turns, _mm256_set1_pd(TWO_PI)));
+    }
+    return _mm256_set_m128(halves[1], halves[0]);
+}
+
+static inline void sinCos(__m256 x, __m256& s, __m256& c) {
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 folded = _mm256_cmp_ps(_mm256_andnot_ps(signMask, x), _mm256_set1_ps(HALF_PI_F), _CMP_GT_OQ);
+    // pi - x for positive angles, -pi - x for negative ones
+    __m256 reflected = _mm256_sub_ps(_mm256_or_ps(_mm256_set1_ps(PI_F), _mm256_and_ps(x, signMask)), x);
+    x = _mm256_blendv_ps(x, reflected, folded);
+
+    __m256 x2 = _mm256_mul_ps(x, x);
+    __m256 p = _mm256_add_ps(_mm256_set1_ps(SIN_9), _mm256_mul_ps(x2, _mm256_set1_ps(SIN_11)));
+    p = _mm256_add_ps(_mm256_set1_ps(SIN_7), _mm256_mul_ps(x2, p));
+    p = _mm256_add_ps(_mm256_set1_ps(SIN_5), _mm256_mul_ps(x2, p));
+    p = _mm256_add_ps(_mm256_set1_ps(SIN_3), _mm256_mul_ps(x2, p));
+    p = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(x2, p));
+    s = _mm256_mul_ps(x, p);
+
+    __m256 q = _mm256_add_ps(_mm256_set1_ps(COS_10), _mm256_mul_ps(x2, _mm256_set1_ps(COS_12)));
+    q = _mm256_add_ps(_mm256_set1_ps(COS_8), _mm256_mul_ps(x2, q));
+    q = _mm256_add_ps(_mm256_set1_ps(COS_6), _mm256_mul_ps(x2, q));
+    q = _mm256_add_ps(_mm256_set1_ps(COS_4), _mm256_mul_ps(x2, q));
+    q = _mm256_add_ps(_mm256_set1_ps(COS_2), _mm256_mul_ps(x2, q));
+    q = _mm256_add_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(x2, q));
+    c = _mm256_xor_ps(q, _mm256_and_ps(folded, signMask));
+}
+#elif defined(BODY_USE_SSE2)
+// SSE2 has no double rounding, the wrap stays scalar
+static inline __m128 wrapAngles(const float* speed, const float* phase, double time) {
+    alignas(16) float angles[4];
+    for (int lane = 0; lane < 4; lane++) {
+        angles[lane] = wrapAngle(speed[lane], phase ? phase[lane] : 0.0f, time);
+    }
+    return _mm_load_ps(angles);
+}
+
+static inline void sinCos(__m128 x, __m128& s, __m128& c) {
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 folded = _mm_cmpgt_ps(_mm_andnot_ps(signMask, x), _mm_set1_ps(HALF_PI_F));
+    __m128 reflected = _mm_sub_ps(_mm_or_ps(_mm_set1_ps(PI_F), _mm_and_ps(x, signMask)), x);
+    x = _mm_or_ps(_mm_and_ps(folded, reflected), _mm_andnot_ps(folded, x));
+
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_add_ps(_mm_set1_ps(SIN_9), _mm_mul_ps(x2, _mm_set1_ps(SIN_11)));
+    p = _mm_add_ps(_mm_set1_ps(SIN_7), _mm_mul_ps(x2, p));
+    p = _mm_add_ps(_mm_set1_ps(SIN_5), _mm_mul_ps(x2, p));
+    p = _mm_add_ps(_mm_set1_ps(SIN_3), _mm_mul_ps(x2, p));
+    p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x2, p));
+    s = _mm_mul_ps(x, p);
+
+    __m128 q = _mm_add_ps(_mm_set1_ps(COS_10), _mm_mul_ps(x2, _mm_set1_ps(COS_12)));
+    q = _mm_add_ps(_mm_set1_ps(COS_8), _mm_mul_ps(x2, q));
+    q = _mm_add_ps(_mm_set1_ps(COS_6), _mm_mul_ps(x2, q));
+    q = _mm_add_ps(_mm_set1_ps(COS_4), _mm_mul_ps(x2, q));
+    q = _mm_add_ps(_mm_set1_ps(COS_2), _mm_mul_ps(x2, q));
+    q = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x2, q));
+    c = _mm_xor_ps(q, _mm_and_ps(folded, signMask));
+}
+#endif
+
+BodyId BodyStore::add(const BodyDesc& desc) {
+    BodyId body = size();
+    orbitRadii.push_back(desc.orbitRadius);
+    orbitSpeeds.push_back(desc.orbitSpeed);
+    orbitPhases.push_back(desc.orbitPhase);
+    heights.push_back(desc.height);
+    spinSpeeds.push_back(desc.spinSpeed);
+    scales.push_back(desc.scale);
+    worldRadii.push_back(desc.boundingRadius * desc.scale);
+    lodPixels.push_back(desc.lodPixels);
+    masses.push_back(desc.mass);
+    centers.push_back(desc.center);
+    materials.push_back(desc.material);
+    meshes.push_back(desc.mesh);
+    for (std::vector<float>* output : {&offsetX, &offsetY, &offsetZ, &spinAngles, &spinCos, &spinSin, &worldX, &worldY, &worldZ}) {
+        output->push_back(0.0f);
+    }
+    spinCos.back() = 1.0f;
+    return body;
+}
+
+void BodyStore::update(double time, JobSystem& jobs) {
+    jobs.parallelFor(size(), [&](int begin, int end) {
+        int i = begin;
+#if defined(__AVX2__)
+        const __m256d time4 = _mm256_set1_pd(time);
+        for (; i + 8 <= end; i += 8) {
+            __m256 s, c;
+            __m256 orbitAngle = wrapAngles(&orbitSpeeds[i], &orbitPhases[i], time4);
+            sinCos(orbitAngle, s, c);
+            __m256 radius = _mm256_loadu_ps(&orbitRadii[i]);
+            _mm256_storeu_ps(&offsetX[i], _mm256_mul_ps(radius, c));
+            _mm256_storeu_ps(&offsetY[i], _mm256_loadu_ps(&heights[i]));
+            _mm256_storeu_ps(&offsetZ[i], _mm256_mul_ps(radius, s));
+
+            __m256 spinAngle = wrapAngles(&spinSpeeds[i], nullptr, time4);
+            sinCos(spinAngle, s, c);
+            _mm256_storeu_ps(&spinAngles[i], spinAngle);
+            _mm256_storeu_ps(&spinCos[i], c);
+            _mm256_storeu_ps(&spinSin[i], s);
+        }
+#elif defined(BODY_USE_SSE2)
+        for (; i + 4 <= end; i += 4) {
+            __m128 s, c;
+            __m128 orbitAngle = wrapAngles(&orbitSpeeds[i], &orbitPhases[i], time);
+            sinCos(orbitAngle, s, c);
+            __m128 radius = _mm_loadu_ps(&orbitRadii[i]);
+            _mm_storeu_ps(&offsetX[i], _mm_mul_ps(radius, c));
+            _mm_storeu_ps(&offsetY[i], _mm_loadu_ps(&heights[i]));
+            _mm_storeu_ps(&offsetZ[i], _mm_mul_ps(radius, s));
+
+            __m128 spinAngle = wrapAngles(&spinSpeeds[i], nullptr, time);
+            sinCos(spinAngle, s, c);
+            _mm_storeu_ps(&spinAngles[i], spinAngle);
+            _mm_storeu_ps(&spinCos[i], c);
+            _mm_storeu_ps(&spinSin[i], s);
+        }
+#endif
+        for (; i < end; i++) {
+            float s, c;
+            sinCos(wrapAngle(orbitSpeeds[i], orbitPhases[i], time), s, c);
+            offsetX[i] = orbitRadii[i] * c;
+            offsetY[i] = heights[i];
+            offsetZ[i] = orbitRadii[i] * s;
+
+            spinAngles[i] = wrapAngle(spinSpeeds[i], 0.0f, time);
+            sinCos(spinAngles[i], spinSin[i], spinCos[i]);
+        }
+    }, BODY_CHUNK);
+}
+
+void BodyStore::resolve(std::span<const glm::vec3> centerPositions, JobSystem& jobs) {
+    jobs.parallelFor(size(), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const glm::vec3& center = centerPositions[centers[i]];
+            worldX[i] = center.x + offsetX[i];
+            worldY[i] = center.y + offsetY[i];
+            worldZ[i] = center.z + offsetZ[i];
+        }
+    }, BODY_CHUNK);
+}
+
+void BodyStore::splitByScreenSize(const std::vector<BodyId>& visible, const glm::mat4& viewProjection, float pixelsPerUnit,
+    std::vector<BodyId>& meshBodies, std::vector<BodyId>& pointBodies) const {
+    meshBodies.clear();
+    pointBodies.clear();
+    // Clip w is the distance along the view direction
+    glm::vec4 depthRow(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+    for (BodyId body : visible) {
+        if (lodPixels[body] > 0.0f) {
+            float depth = depthRow.x * worldX[body] + depthRow.y * worldY[body] + depthRow.z * worldZ[body] + depthRow.w;
+            // Bodies reaching behind the near plane always get their mesh
+            if (depth > worldRadii[body] && worldRadii[body] * pixelsPerUnit < lodPixels[body] * depth) {
+                pointBodies.push_back(body);
+                continue;
+            }
+        }
+        meshBodies.push_back(body);
+    }
+}
+
+glm::mat4 BodyStore::modelMatrix(BodyId body) const {
+    float scale = scales[body];
+    float c = spinCos[body];
+    float s = spinSin[body];
+    glm::mat4 matrix(1.0f);
+    matrix[0] = glm::vec4(scale * c, 0.0f, -scale * s, 0.0f);
+    matrix[1] = glm::vec4(0.0f, scale, 0.0f, 0.0f);
+    matrix[2] = glm::vec4(scale * s, 0.0f, scale * c, 0.0f);
+    matrix[3] = glm::vec4(worldX[body], worldY[body], worldZ[body], 1.0f);
+    return matrix;
+}
@@ -0,0 +1,434 @@
+#include "BoundingVolumeHierarchy.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define BVH_USE_SSE2
+#endif
+
+// Candidate split planes per axis
+const int SAH_BINS = 16;
+// Nodes with up to this many items are always leaves
+const int MIN_LEAF_ITEMS = 4;
+// Nodes with more items than this are always split
+const int MAX_LEAF_ITEMS = 16;
+// Nodes with more items than this build their two children as separate tasks
+const int PARALLEL_BUILD_ITEMS = 4096;
+// Past this depth nodes split at the median, which bounds the depth for any input
+const int MAX_SAH_DEPTH = 48;
+// Every level of a traversal leaves at most one sibling pending
+const int BVH_STACK = 128;
+// Items per task when refit() copies the spheres
+const int REFIT_CHUNK = 4096;
+
+// Bounds being accumulated. A box takes 6 compares per grow, which dominates build();
+// with SSE2 it is one min and one max over xyz at once.
+#ifdef BVH_USE_SSE2
+struct Box {
+    __m128 low = _mm_set1_ps(std::numeric_limits<float>::max());
+    __m128 high = _mm_set1_ps(-std::numeric_limits<float>::max());
+
+    void grow(const Box& box) {
+        low = _mm_min_ps(low, box.low);
+        high = _mm_max_ps(high, box.high);
+    }
+    void grow(const glm::vec3& min, const glm::vec3& max) {
+        low = _mm_min_ps(low, _mm_setr_ps(min.x, min.y, min.z, 0.0f));
+        high = _mm_max_ps(high, _mm_setr_ps(max.x, max.y, max.z, 0.0f));
+    }
+    void grow(const glm::vec4& sphere) {
+        __m128 center = _mm_loadu_ps(&sphere.x);
+        __m128 radius = _mm_shuffle_ps(center, center, _MM_SHUFFLE(3, 3, 3, 3));
+        low = _mm_min_ps(low, _mm_sub_ps(center, radius));
+        high = _mm_max_ps(high, _mm_add_ps(center, radius));
+    }
+    // Only the center of the sphere, the w lane carries along unused
+    void growCenter(const glm::vec4& sphere) {
+        __m128 center = _mm_loadu_ps(&sphere.x);
+        low = _mm_min_ps(low, center);
+        high = _mm_max_ps(high, center);
+    }
+    glm::vec3 min() const {
+        alignas(16) float values[4];
+        _mm_store_ps(values, low);
+        return glm::vec3(values[0], values[1], values[2]);
+    }
+    glm::vec3 max() const {
+        alignas(16) float values[4];
+        _mm_store_ps(values, high);
+        return glm::vec3(values[0], values[1], values[2]);
+    }
+    float area() const {
+        alignas(16) float size[4];
+        _mm_store_ps(size, _mm_sub_ps(high, low));
+        return size[0] < 0.0f ? 0.0f : 2.0f * (size[0] * size[1] + size[1] * size[2] + size[2] * size[0]);
+    }
+};
+#else
+struct Box {
+    glm::vec3 low = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 high = glm::vec3(-std::numeric_limits<float>::max());
+
+    void grow(const Box& box) { grow(box.low, box.high); }
+    void grow(const glm::vec3& min, const glm::vec3& max) {
+        low = glm::vec3(std::min(low.x, min.x), std::min(low.y, min.y), std::min(low.z, min.z));
+        high = glm::vec3(std::max(high.x, max.x), std::max(high.y, max.y), std::max(high.z, max.z));
+    }
+    void grow(const glm::vec4& sphere) {
+        glm::vec3 center(sphere);
+        grow(center - glm::vec3(sphere.w), center + glm::vec3(sphere.w));
+    }
+    void growCenter(const glm::vec4& sphere) { grow(glm::vec3(sphere), glm::vec3(sphere)); }
+    glm::vec3 min() const { return low; }
+    glm::vec3 max() const { return high; }
+    float area() const {
+        glm::vec3 size = high - low;
+        return size.x < 0.0f ? 0.0f : 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+};
+#endif
+
+static float area(const BvhNode& node) {
+    Box box;
+    box.grow(node.min, node.max);
+    return box.area();
+}
+
+// Nearest point of the box along the ray, or infinity if the ray misses it
+static float rayBoxEntry(const BvhNode& node, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) {
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t0 = (node.min[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (node.max[axis] - origin[axis]) * inverseDirection[axis];
+        tMin = std::max(tMin, std::min(t0, t1));
+        tMax = std::min(tMax, std::max(t0, t1));
+    }
+    return tMin <= tMax ? tMin : std::numeric_limits<float>::infinity();
+}
+
+static float pointBoxDistance(const BvhNode& node, const glm::vec3& point) {
+    glm::vec3 outside(
+        std::max({node.min.x - point.x, 0.0f, point.x - node.max.x}),
+        std::max({node.min.y - point.y, 0.0f, point.y - node.max.y}),
+        std::max({node.min.z - point.z, 0.0f, point.z - node.max.z}));
+    return glm::length(outside);
+}
+
+void BoundingVolumeHierarchy::build(const SphereBounds& spheres, JobSystem& jobs) {
+    int count = spheres.size();
+    nodes.clear();
+    levelOrder.clear();
+    levelStarts.clear();
+    items.resize(count);
+    itemSpheres.resize(count);
+    if (count == 0)
+        return;
+
+    buildItems.resize(count);
+    for (int i = 0; i < count; i++) {
+        buildItems[i] = BuildItem{glm::vec4(spheres.center(i), spheres.radius[i]), i};
+    }
+    // A binary tree with at least one item per leaf has fewer than 2n nodes
+    nodes.resize(2 * count);
+    nextNode = 1;
+    buildNode(0, 0, count, 0, jobs);
+    nodes.resize(nextNode);
+    for (int i = 0; i < count; i++) {
+        items[i] = buildItems[i].object;
+        itemSpheres[i] = buildItems[i].sphere;
+    }
+
+    // Group the nodes by depth, refit() does one level at a time from the bottom
+    levelOrder.push_back(0);
+    for (size_t begin = 0; begin < levelOrder.size();) {
+        size_t end = levelOrder.size();
+        levelStarts.push_back(static_cast<int>(begin));
+        for (size_t i = begin; i < end; i++) {
+            const BvhNode& node = nodes[levelOrder[i]];
+            if (node.firstChild >= 0) {
+                levelOrder.push_back(node.firstChild);
+                levelOrder.push_back(node.firstChild + 1);
+            }
+        }
+        begin = end;
+    }
+    levelStarts.push_back(static_cast<int>(levelOrder.size()));
+
+    builtCost = currentCost = surfaceAreaCost();
+}
+
+void BoundingVolumeHierarchy::buildNode(int index, int first, int count, int depth, JobSystem& jobs) {
+    BuildItem* begin = buildItems.data() + first;
+    BuildItem* end = begin + count;
+    Box bounds;
+    Box centerBounds;
+    for (const BuildItem* item = begin; item < end; item++) {
+        bounds.grow(item->sphere);
+        centerBounds.growCenter(item->sphere);
+    }
+    BvhNode& node = nodes[index];
+    node.min = bounds.min();
+    node.max = bounds.max();
+    node.firstItem = first;
+    node.itemCount = count;
+    node.firstChild = -1;
+    if (count <= MIN_LEAF_ITEMS)
+        return;
+
+    glm::vec3 extent = centerBounds.max() - centerBounds.min();
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    // With every center in one spot any split is as good as another, keep it at the middle
+    BuildItem* split = begin + count / 2;
+    if (extent[axis] <= 0.0f) {
+        if (count <= MAX_LEAF_ITEMS)
+            return;
+    } else if (depth >= MAX_SAH_DEPTH) {
+        std::nth_element(begin, split, end, [axis](const BuildItem& a, const BuildItem& b) { return a.sphere[axis] < b.sphere[axis]; });
+    } else {
+        // Binned surface area heuristic along the longest axis of the centers
+        struct Bin {
+            Box box;
+            int count = 0;
+        };
+        Bin bins[SAH_BINS];
+        float binMin = centerBounds.min()[axis];
+        float binScale = SAH_BINS / extent[axis];
+        auto binOf = [=](const BuildItem& item) {
+            return std::min(SAH_BINS - 1, static_cast<int>((item.sphere[axis] - binMin) * binScale));
+        };
+        for (const BuildItem* item = begin; item < end; item++) {
+            Bin& bin = bins[binOf(*item)];
+            bin.box.grow(item->sphere);
+            bin.count++;
+        }
+
+        // Cost of every split plane: right sides swept backwards, left sides forwards
+        float rightArea[SAH_BINS];
+        int rightCount[SAH_BINS];
+        Box right;
+        int rightItems = 0;
+        for (int b = SAH_BINS - 1; b > 0; b--) {
+            right.grow(bins[b].box);
+            rightItems += bins[b].count;
+            rightArea[b] = right.area();
+            rightCount[b] = rightItems;
+        }
+        Box left;
+        int leftItems = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        int bestPlane = -1;
+        for (int b = 1; b < SAH_BINS; b++) {
+            left.grow(bins[b - 1].box);
+            leftItems += bins[b - 1].count;
+            if (leftItems == 0 || rightCount[b] == 0)
+                continue;
+            float cost = left.area() * leftItems + rightArea[b] * rightCount[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestPlane = b;
+            }
+        }
+
+        // A leaf costs one test per item, a split one box test plus its children
+        if (count <= MAX_LEAF_ITEMS && bounds.area() + bestCost >= bounds.area() * count)
+            return;
+        split = std::partition(begin, end, [&](const BuildItem& item) { return binOf(item) < bestPlane; });
+    }
+
+    int firstChild = nextNode.fetch_add(2);
+    node.firstChild = firstChild;
+    int firsts[2] = {first, static_cast<int>(split - buildItems.data())};
+    int counts[2] = {firsts[1] - first, first + count - firsts[1]};
+    if (count > PARALLEL_BUILD_ITEMS) {
+        jobs.parallelFor(2, [&](int begin, int end) {
+            for (int c = begin; c < end; c++) {
+                buildNode(firstChild + c, firsts[c], counts[c], depth + 1, jobs);
+            }
+        }, 1);
+    } else {
+        buildNode(firstChild, firsts[0], counts[0], depth + 1, jobs);
+        buildNode(firstChild + 1, firsts[1], counts[1], depth + 1, jobs);
+    }
+}
+
+void BoundingVolumeHierarchy::refit(const SphereBounds& spheres, JobSystem& jobs) {
+    // Gather the spheres into leaf order, the only pass that reads them by object id
+    jobs.parallelFor(static_cast<int>(items.size()), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            itemSpheres[i] = glm::vec4(spheres.center(items[i]), spheres.radius[items[i]]);
+        }
+    }, REFIT_CHUNK);
+
+    // Deepest level first, so every node's children are already up to date
+    for (int level = static_cast<int>(levelStarts.size()) - 2; level >= 0; level--) {
+        int begin = levelStarts[level];
+        jobs.parallelFor(levelStarts[level + 1] - begin, [&](int first, int last) {
+            for (int i = begin + first; i < begin + last; i++) {
+                BvhNode& node = nodes[levelOrder[i]];
+                Box box;
+                if (node.firstChild < 0) {
+                    for (int item = node.firstItem; item < node.firstItem + node.itemCount; item++) {
+                        box.grow(itemSpheres[item]);
+                    }
+                } else {
+                    const BvhNode& left = nodes[node.firstChild];
+                    const BvhNode& right = nodes[node.firstChild + 1];
+                    box.grow(left.min, left.max);
+                    box.grow(right.min, right.max);
+                }
+                node.min = box.min();
+                node.max = box.max();
+            }
+        }, 256);
+    }
+    currentCost = surfaceAreaCost();
+}
+
+// Sum of the node areas relative to the root, leaves weighted by their item count: the
+// expected number of tests of a query for a random ray or point
+float BoundingVolumeHierarchy::surfaceAreaCost() const {
+    if (nodes.empty())
+        return 0.0f;
+    double cost = 0.0;
+    for (const BvhNode& node : nodes) {
+        cost += area(node) * (node.firstChild < 0 ? node.itemCount : 1);
+    }
+    float rootArea = area(nodes[0]);
+    return rootArea > 0.0f ? static_cast<float>(cost / rootArea) : 0.0f;
+}
+
+void BoundingVolumeHierarchy::cull(const Frustum& frustum, const glm::vec3& eye, std::vector<int>& visible) const {
+    visible.clear();
+    if (nodes.empty())
+        return;
+
+    int stack[BVH_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes[stack[--top]];
+
+        // Outside if the corner furthest along a plane's normal is behind it, entirely
+        // inside if even the nearest corner is in front of every plane
+        bool inside = true;
+        bool outside = false;
+        for (const glm::vec4& plane : frustum.planes) {
+            glm::vec3 far(plane.x > 0.0f ? node.max.x : node.min.x, plane.y > 0.0f ? node.max.y : node.min.y, plane.z > 0.0f ? node.max.z : node.min.z);
+            glm::vec3 near(plane.x > 0.0f ? node.min.x : node.max.x, plane.y > 0.0f ? node.min.y : node.max.y, plane.z > 0.0f ? node.min.z : node.max.z);
+            if (glm::dot(glm::vec3(plane), far) + plane.w < 0.0f) {
+                outside = true;
+                break;
+            }
+            if (glm::dot(glm::vec3(plane), near) + plane.w < 0.0f)
+                inside = false;
+        }
+        if (outside)
+            continue;
+
+        if (inside) {
+            visible.insert(visible.end(), items.begin() + node.firstItem, items.begin() + node.firstItem + node.itemCount);
+        } else if (node.firstChild < 0) {
+            for (int item = node.firstItem; item < node.firstItem + node.itemCount; item++) {
+                if (frustum.intersectsSphere(glm::vec3(itemSpheres[item]), itemSpheres[item].w))
+                    visible.push_back(items[item]);
+            }
+        } else {
+            // The nearer child goes on top of the stack
+            const BvhNode& left = nodes[node.firstChild];
+            const BvhNode& right = nodes[node.firstChild + 1];
+            glm::vec3 toLeft = (left.min + left.max) * 0.5f - eye;
+            glm::vec3 toRight = (right.min + right.max) * 0.5f - eye;
+            bool leftNearer = glm::dot(toLeft, toLeft) < glm::dot(toRight, toRight);
+            stack[top++] = leftNearer ? node.firstChild + 1 : node.firstChild;
+            stack[top++] = leftNearer ? node.firstChild : node.firstChild + 1;
+        }
+    }
+}
+
+BvhHit BoundingVolumeHierarchy::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const {
+    BvhHit hit;
+    if (nodes.empty())
+        return hit;
+    // Division by a zero component gives infinity, which the slab test handles
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float best = maxDistance;
+
+    int stack[BVH_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes[stack[--top]];
+        if (rayBoxEntry(node, origin, inverseDirection, best) > best)
+            continue;
+
+        if (node.firstChild < 0) {
+            for (int item = node.firstItem; item < node.firstItem + node.itemCount; item++) {
+                glm::vec3 toCenter = glm::vec3(itemSpheres[item]) - origin;
+                float along = glm::dot(toCenter, direction);
+                float radius2 = itemSpheres[item].w * itemSpheres[item].w;
+                float miss2 = glm::dot(toCenter, toCenter) - along * along;
+                if (miss2 > radius2)
+                    continue;
+                float halfChord = std::sqrt(radius2 - miss2);
+                // From inside a sphere the exit point counts
+                float t = along - halfChord >= 0.0f ? along - halfChord : along + halfChord;
+                if (t >= 0.0f && t < best) {
+                    best = t;
+                    hit = BvhHit{items[item], t};
+                }
+            }
+            continue;
+        }
+
+        // Visit the child the ray enters first, push the other one below it
+        float leftEntry = rayBoxEntry(nodes[node.firstChild], origin, inverseDirection, best);
+        float rightEntry = rayBoxEntry(nodes[node.firstChild + 1], origin, inverseDirection, best);
+        bool leftFirst = leftEntry <= rightEntry;
+        if ((leftFirst ? rightEntry : leftEntry) <= best)
+            stack[top++] = leftFirst ? node.firstChild + 1 : node.firstChild;
+        if ((leftFirst ? leftEntry : rightEntry) <= best)
+            stack[top++] = leftFirst ? node.firstChild : node.firstChild + 1;
+    }
+    return hit;
+}
+
+BvhHit BoundingVolumeHierarchy::nearest(const glm::vec3& point, float maxDistance) const {
+    BvhHit hit;
+    if (nodes.empty())
+        return hit;
+    float best = maxDistance;
+
+    int stack[BVH_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes[stack[--top]];
+        if (pointBoxDistance(node, point) > best)
+            continue;
+
+        if (node.firstChild < 0) {
+            for (int item = node.firstItem; item < node.firstItem + node.itemCount; item++) {
+                float distance = std::max(0.0f, glm::length(glm::vec3(itemSpheres[item]) - point) - itemSpheres[item].w);
+                if (distance < best || (distance == best && hit.object < 0)) {
+                    best = distance;
+                    hit = BvhHit{items[item], distance};
+                }
+            }
+            continue;
+        }
+
+        float leftDistance = pointBoxDistance(nodes[node.firstChild], point);
+        float rightDistance = pointBoxDistance(nodes[node.firstChild + 1], point);
+        bool leftFirst = leftDistance <= rightDistance;
+        if ((leftFirst ? rightDistance : leftDistance) <= best)
+            stack[top++] = leftFirst ? node.firstChild + 1 : node.firstChild;
+        if ((leftFirst ? leftDistance : rightDistance) <= best)
+            stack[top++] = leftFirst ? node.firstChild : node.firstChild + 1;
+    }
+    return hit;
+}
@@ -0,0 +1,180 @@
+#include "BvhBenchmark.h"
+#include "BodyStore.h"
+#include "BoundingVolumeHierarchy.h"
+#include "FastRandom.h"
+#include "FrameStats.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "glm/gtc/matrix_transform.hpp"
+
+// Builds and refits timed, and the views culled
+const int BENCHMARK_REPEATS = 10;
+// Scene time between refits
+const double BENCHMARK_FRAME_SECONDS = 1.0 / 60.0;
+// Rays and nearest queries timed, and how many of them are checked by brute force,
+// which is a loop over every body per query
+const int BENCHMARK_QUERIES = 100000;
+const int BENCHMARK_CHECKED_QUERIES = 1000;
+// Brute force and the tree may round a distance differently
+const float BENCHMARK_DISTANCE_TOLERANCE = 1e-3f;
+
+// The queries answered by looking at every body, like the tree does per leaf item
+
+static std::vector<int> cullAll(const BodyStore& bodies, const Frustum& frustum) {
+    std::vector<int> visible;
+    for (BodyId body = 0; body < bodies.size(); body++) {
+        if (frustum.intersectsSphere(bodies.position(body), bodies.boundingRadius(body)))
+            visible.push_back(body);
+    }
+    return visible;
+}
+
+static BvhHit raycastAll(const BodyStore& bodies, const glm::vec3& origin, const glm::vec3& direction) {
+    BvhHit hit;
+    float best = std::numeric_limits<float>::max();
+    for (BodyId body = 0; body < bodies.size(); body++) {
+        glm::vec3 toCenter = bodies.position(body) - origin;
+        float along = glm::dot(toCenter, direction);
+        float radius2 = bodies.boundingRadius(body) * bodies.boundingRadius(body);
+        float miss2 = glm::dot(toCenter, toCenter) - along * along;
+        if (miss2 > radius2)
+            continue;
+        float halfChord = std::sqrt(radius2 - miss2);
+        float t = along - halfChord >= 0.0f ? along - halfChord : along + halfChord;
+        if (t >= 0.0f && t < best) {
+            best = t;
+            hit = BvhHit{body, t};
+        }
+    }
+    return hit;
+}
+
+static BvhHit nearestAll(const BodyStore& bodies, const glm::vec3& point) {
+    BvhHit hit;
+    float best = std::numeric_limits<float>::max();
+    for (BodyId body = 0; body < bodies.size(); body++) {
+        float distance = std::max(0.0f, glm::length(bodies.position(body) - point) - bodies.boundingRadius(body));
+        if (distance < best) {
+            best = distance;
+            hit = BvhHit{body, distance};
+        }
+    }
+    return hit;
+}
+
+// Ties between bodies may go either way, so hits agree when their distances do
+static bool sameHit(const BvhHit& a, const BvhHit& b) {
+    if (a.object < 0 || b.object < 0)
+        return a.object == b.object;
+    return std::abs(a.distance - b.distance) <= BENCHMARK_DISTANCE_TOLERANCE * std::max(1.0f, b.distance);
+}
+
+bool benchmarkBvh(BodyStore& bodies, std::span<const glm::vec3> centers, const glm::mat4& projection, JobSystem& jobs) {
+    bodies.update(0.0, jobs);
+    bodies.resolve(centers, jobs);
+    SphereBounds bounds = bodies.bounds();
+    SDL_Log("BVH benchmark: %d bodies, %u workers", bodies.size(), jobs.threadCount());
+
+    // Eyes anywhere in the bodies' box grown by half, looking at a random body
+    glm::vec3 boxMin(std::numeric_limits<float>::max());
+    glm::vec3 boxMax(-std::numeric_limits<float>::max());
+    for (BodyId body = 0; body < bodies.size(); body++) {
+        boxMin = glm::min(boxMin, bodies.position(body));
+        boxMax = glm::max(boxMax, bodies.position(body));
+    }
+    glm::vec3 boxCenter = (boxMin + boxMax) * 0.5f;
+    glm::vec3 boxHalf = (boxMax - boxMin) * 0.75f;
+    FastRandom random(45);
+    auto randomEye = [&] {
+        return boxCenter + boxHalf * glm::vec3(random.uniform(-1.0f, 1.0f), random.uniform(-1.0f, 1.0f), random.uniform(-1.0f, 1.0f));
+    };
+    auto randomBody = [&] {
+        return bodies.position(static_cast<BodyId>(random.next() % static_cast<uint32_t>(bodies.size())));
+    };
+
+    BoundingVolumeHierarchy bvh;
+    bool passed = true;
+
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < BENCHMARK_REPEATS; i++) {
+        bvh.build(bounds, jobs);
+    }
+    SDL_Log("  build %.2f ms, %d nodes, cost %.1f", FrameStats::milliseconds(SDL_GetPerformanceCounter() - start) / BENCHMARK_REPEATS,
+        bvh.nodeCount(), bvh.cost());
+
+    // A frame of scene time apart, then rebuilt if that loosened it, like main does
+    Uint64 refitCounter = 0;
+    for (int i = 1; i <= BENCHMARK_REPEATS; i++) {
+        bodies.update(i * BENCHMARK_FRAME_SECONDS, jobs);
+        bodies.resolve(centers, jobs);
+        start = SDL_GetPerformanceCounter();
+        bvh.refit(bounds, jobs);
+        refitCounter += SDL_GetPerformanceCounter() - start;
+    }
+    SDL_Log("  refit %.2f ms, cost %.1f, degraded %s", FrameStats::milliseconds(refitCounter) / BENCHMARK_REPEATS, bvh.cost(),
+        bvh.degraded() ? "yes" : "no");
+    if (bvh.degraded())
+        bvh.build(bounds, jobs);
+
+    // Queries run on the refitted tree, the brute force on the same positions
+    Uint64 cullCounter = 0;
+    size_t culled = 0;
+    int cullMismatches = 0;
+    std::vector<int> visible;
+    for (int i = 0; i < BENCHMARK_REPEATS; i++) {
+        glm::vec3 eye = randomEye();
+        Frustum frustum = Frustum::fromMatrix(projection * glm::lookAt(eye, randomBody(), glm::vec3(0, 1, 0)));
+        start = SDL_GetPerformanceCounter();
+        bvh.cull(frustum, eye, visible);
+        cullCounter += SDL_GetPerformanceCounter() - start;
+        culled += visible.size();
+
+        std::sort(visible.begin(), visible.end());
+        cullMismatches += visible == cullAll(bodies, frustum) ? 0 : 1;
+    }
+    SDL_Log("  cull %.3f ms, %zu visible on average, %d of %d views differ from brute force", FrameStats::milliseconds(cullCounter) / BENCHMARK_REPEATS,
+        culled / BENCHMARK_REPEATS, cullMismatches, BENCHMARK_REPEATS);
+    passed = passed && cullMismatches == 0;
+
+    std::vector<glm::vec3> origins(BENCHMARK_QUERIES);
+    std::vector<glm::vec3> directions(BENCHMARK_QUERIES);
+    for (int i = 0; i < BENCHMARK_QUERIES; i++) {
+        origins[i] = randomEye();
+        directions[i] = glm::normalize(randomBody() - origins[i]);
+    }
+    std::vector<BvhHit> hits(BENCHMARK_QUERIES);
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < BENCHMARK_QUERIES; i++) {
+        hits[i] = bvh.raycast(origins[i], directions[i], std::numeric_limits<float>::max());
+    }
+    double raycastMilliseconds = FrameStats::milliseconds(SDL_GetPerformanceCounter() - start);
+    int raycastMismatches = 0;
+    for (int i = 0; i < BENCHMARK_CHECKED_QUERIES; i++) {
+        raycastMismatches += sameHit(hits[i], raycastAll(bodies, origins[i], directions[i])) ? 0 : 1;
+    }
+    SDL_Log("  raycast %.2f M rays/s, %d of %d differ from brute force", BENCHMARK_QUERIES / raycastMilliseconds / 1000.0,
+        raycastMismatches, BENCHMARK_CHECKED_QUERIES);
+    passed = passed && raycastMismatches == 0;
+
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < BENCHMARK_QUERIES; i++) {
+        hits[i] = bvh.nearest(origins[i], std::numeric_limits<float>::max());
+    }
+    double nearestMilliseconds = FrameStats::milliseconds(SDL_GetPerformanceCounter() - start);
+    int nearestMismatches = 0;
+    for (int i = 0; i < BENCHMARK_CHECKED_QUERIES; i++) {
+        nearestMismatches += sameHit(hits[i], nearestAll(bodies, origins[i])) ? 0 : 1;
+    }
+    SDL_Log("  nearest %.2f M queries/s, %d of %d differ from brute force", BENCHMARK_QUERIES / nearestMilliseconds / 1000.0,
+        nearestMismatches, BENCHMARK_CHECKED_QUERIES);
+    passed = passed && nearestMismatches == 0;
+
+    SDL_Log("BVH benchmark %s", passed ? "passed" : "FAILED");
+    return passed;
+}
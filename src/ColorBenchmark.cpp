@@ -0,0 +1,162 @@
+#include "ColorBenchmark.h"
+#include "Color.h"
+#include "FastRandom.h"
+#include "FrameStats.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <vector>
+
+// Pixels shaded per pass, and the passes timed after an untimed one
+const int COLOR_BENCHMARK_PIXELS = 1 << 20;
+const int COLOR_BENCHMARK_REPEATS = 10;
+
+// Color as it was before the SSE2 operators, one channel at a time with int clamps
+struct ScalarColor {
+    Uint8 red;
+    Uint8 green;
+    Uint8 blue;
+    Uint8 alpha;
+
+    ScalarColor() : red(255), green(255), blue(255), alpha(255) {}
+
+    ScalarColor(int r, int g, int b, int a = 255) {
+        red =   static_cast<Uint8>((r > 255) ? 255 : ((r < 0) ? 0 : r));
+        green = static_cast<Uint8>((g > 255) ? 255 : ((g < 0) ? 0 : g));
+        blue =  static_cast<Uint8>((b > 255) ? 255 : ((b < 0) ? 0 : b));
+        alpha = static_cast<Uint8>((a > 255) ? 255 : ((a < 0) ? 0 : a));
+    }
+
+    ScalarColor operator+(const ScalarColor& other) const {
+        int r = static_cast<int>(red) + static_cast<int>(other.red);
+        int g = static_cast<int>(green) + static_cast<int>(other.green);
+        int b = static_cast<int>(blue) + static_cast<int>(other.blue);
+        int a = static_cast<int>(alpha) + static_cast<int>(other.alpha);
+        return ScalarColor(r, g, b, a);
+    }
+
+    ScalarColor operator*(float scalar) const {
+        Uint8 r = static_cast<Uint8>(std::max(0.0f, std::min(red * scalar, 255.0f)));
+        Uint8 g = static_cast<Uint8>(std::max(0.0f, std::min(green * scalar, 255.0f)));
+        Uint8 b = static_cast<Uint8>(std::max(0.0f, std::min(blue * scalar, 255.0f)));
+        return ScalarColor(r, g, b, 255);
+    }
+
+    Uint32 pack() const {
+        return (static_cast<Uint32>(alpha) << 24) | (static_cast<Uint32>(red) << 16) | (static_cast<Uint32>(green) << 8) | static_cast<Uint32>(blue);
+    }
+};
+
+// What the shaders get per pixel, noise already sampled
+struct ColorBenchmarkInputs {
+    std::vector<float> intensity;
+    std::vector<float> elevation;
+    std::vector<float> coverage;
+    std::vector<float> noise;
+};
+
+// EarthPlanetFragmentShader's per pixel math, on C
+template <typename C>
+static void shadeEarth(const ColorBenchmarkInputs& in, Uint32* out) {
+    for (int i = 0; i < COLOR_BENCHMARK_PIXELS; i++) {
+        float height = (10.0f * in.elevation[i] + 1.0f) * 0.5f;
+        C fragmentColor;
+        if (height > 0.88f)
+            fragmentColor = C(0, 160, 0);
+        else if (height > 0.6f)
+            fragmentColor = C(173, 216, 230);
+        else
+            fragmentColor = C(0, 0, 128);
+
+        float coverage = (in.coverage[i] + 1.0f) * 0.5f;
+        if (coverage > 0.7f)
+            fragmentColor = fragmentColor + C(220, 220, 220) * coverage;
+
+        fragmentColor = fragmentColor * (1.0f + 0.5f * in.noise[i]);
+        fragmentColor = fragmentColor * (in.intensity[i] * (1.0f - height * 0.1f));
+        out[i] = fragmentColor.pack();
+    }
+}
+
+// RedPlanetFragmentShader's per pixel math, on C
+template <typename C>
+static void shadeRedPlanet(const ColorBenchmarkInputs& in, Uint32* out) {
+    C baseColor = C(255, 0, 0);
+    C highLightColor = C(0, 255, 255);
+    for (int i = 0; i < COLOR_BENCHMARK_PIXELS; i++) {
+        float noiseValue = (in.noise[i] + 1.0f) * 0.5f;
+        C fragmentColor = baseColor * noiseValue + highLightColor * (1 - noiseValue + 0.1f);
+        out[i] = (fragmentColor * in.intensity[i]).pack();
+    }
+}
+
+// Milliseconds per pass of shade, which leaves its last pass in out
+template <typename Shade>
+static double timeShader(Shade shade, const ColorBenchmarkInputs& in, std::vector<Uint32>& out) {
+    shade(in, out.data());
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < COLOR_BENCHMARK_REPEATS; i++) {
+        shade(in, out.data());
+    }
+    return FrameStats::milliseconds(SDL_GetPerformanceCounter() - start) / COLOR_BENCHMARK_REPEATS;
+}
+
+static int countDifferences(const std::vector<Uint32>& a, const std::vector<Uint32>& b) {
+    int differences = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        differences += a[i] != b[i] ? 1 : 0;
+    }
+    return differences;
+}
+
+bool benchmarkColor() {
+#ifdef COLOR_USE_SSE2
+    const char* colorPath = "SSE2";
+#else
+    const char* colorPath = "scalar fallback";
+#endif
+    SDL_Log("Color benchmark: %d pixels, Color uses %s", COLOR_BENCHMARK_PIXELS, colorPath);
+
+    // Noise in -1 to 1 as FastNoiseLite gives it, intensity a bit past 1 like a lit rim
+    ColorBenchmarkInputs in;
+    FastRandom random(31);
+    for (int i = 0; i < COLOR_BENCHMARK_PIXELS; i++) {
+        in.intensity.push_back(random.uniform(0.0f, 1.2f));
+        in.elevation.push_back(random.uniform(-0.1f, 0.1f));
+        in.coverage.push_back(random.uniform(-1.0f, 1.0f));
+        in.noise.push_back(random.uniform(-1.0f, 1.0f));
+    }
+
+    std::vector<Uint32> scalarPixels(COLOR_BENCHMARK_PIXELS);
+    std::vector<Uint32> colorPixels(COLOR_BENCHMARK_PIXELS);
+    std::vector<Uint32> floatPixels(COLOR_BENCHMARK_PIXELS);
+    bool passed = true;
+
+    struct Shader {
+        const char* name;
+        void (*scalar)(const ColorBenchmarkInputs&, Uint32*);
+        void (*color)(const ColorBenchmarkInputs&, Uint32*);
+        void (*colorF)(const ColorBenchmarkInputs&, Uint32*);
+    };
+    const Shader shaders[] = {
+        {"earth", shadeEarth<ScalarColor>, shadeEarth<Color>, shadeEarth<ColorF>},
+        {"red planet", shadeRedPlanet<ScalarColor>, shadeRedPlanet<Color>, shadeRedPlanet<ColorF>},
+    };
+    for (const Shader& shader : shaders) {
+        double scalarMilliseconds = timeShader(shader.scalar, in, scalarPixels);
+        double colorMilliseconds = timeShader(shader.color, in, colorPixels);
+        double floatMilliseconds = timeShader(shader.colorF, in, floatPixels);
+        double megapixels = COLOR_BENCHMARK_PIXELS / 1000000.0;
+
+        // ColorF only clamps at the end, so it may round differently and isn't checked
+        int differences = countDifferences(scalarPixels, colorPixels);
+        SDL_Log("  %s: scalar Color %.2f ms (%.0f Mpix/s), Color %.2f ms (%.0f Mpix/s), ColorF %.2f ms (%.0f Mpix/s), "
+            "%d pixels differ from scalar", shader.name, scalarMilliseconds, megapixels / scalarMilliseconds * 1000.0,
+            colorMilliseconds, megapixels / colorMilliseconds * 1000.0, floatMilliseconds, megapixels / floatMilliseconds * 1000.0,
+            differences);
+        passed = passed && differences == 0;
+    }
+
+    SDL_Log("Color benchmark %s", passed ? "passed" : "FAILED");
+    return passed;
+}
@@ -0,0 +1,81 @@
+#include "GravityBenchmark.h"
+#include "FastRandom.h"
+#include "FrameStats.h"
+#include "GravitySimulation.h"
+#include "JobSystem.h"
+
+#include <SDL2/SDL.h>
+#include <cmath>
+#include <cstring>
+
+// Body counts timed, and the steps averaged at each; the first step isn't timed as it
+// also sizes every buffer
+const int GRAVITY_BENCHMARK_SIZES[] = {10000, 100000, 1000000};
+const int GRAVITY_BENCHMARK_STEPS[] = {20, 5, 2};
+// Bodies and steps of the thread count comparison
+const int GRAVITY_DETERMINISM_BODIES = 100000;
+const int GRAVITY_DETERMINISM_STEPS = 3;
+const float GRAVITY_BENCHMARK_STEP = 1.0f / 60.0f;
+
+// count bodies on circular orbits in a thin disk around a central mass, like the belt
+static void addDisk(GravitySimulation& gravity, int count) {
+    const float CENTRAL_MASS = 100000.0f;
+    gravity.clear();
+    gravity.add(glm::vec3(0), glm::vec3(0), CENTRAL_MASS);
+    FastRandom random(44);
+    for (int i = 1; i < count; i++) {
+        float radius = random.uniform(20.0f, 220.0f);
+        float angle = 6.2831853f * random.uniform();
+        float speed = std::sqrt(gravity.gravitationalConstant * CENTRAL_MASS / radius);
+        glm::vec3 position(radius * std::cos(angle), random.uniform(-2.0f, 2.0f), radius * std::sin(angle));
+        glm::vec3 velocity(-speed * std::sin(angle), 0.0f, speed * std::cos(angle));
+        gravity.add(position, velocity, random.uniform(0.01f, 1.0f));
+    }
+}
+
+bool benchmarkGravity(JobSystem& jobs) {
+    SDL_Log("Gravity benchmark: %u workers, theta %.2f", jobs.threadCount(), GravitySimulation().theta);
+
+    for (int size = 0; size < 3; size++) {
+        GravitySimulation gravity;
+        addDisk(gravity, GRAVITY_BENCHMARK_SIZES[size]);
+        gravity.step(GRAVITY_BENCHMARK_STEP, jobs);
+
+        int steps = GRAVITY_BENCHMARK_STEPS[size];
+        double buildSeconds = 0.0;
+        double forceSeconds = 0.0;
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (int step = 0; step < steps; step++) {
+            gravity.step(GRAVITY_BENCHMARK_STEP, jobs);
+            buildSeconds += gravity.buildSeconds();
+            forceSeconds += gravity.forceSeconds();
+        }
+        SDL_Log("  %d bodies: %.1f ms/step (tree %.1f ms, forces %.1f ms), %d nodes", gravity.size(),
+            FrameStats::milliseconds(SDL_GetPerformanceCounter() - start) / steps, buildSeconds * 1000.0 / steps,
+            forceSeconds * 1000.0 / steps, gravity.nodeCount());
+    }
+
+    // The same steps on one worker and on several must agree to the bit
+    JobSystem other(jobs.threadCount() == 1 ? 4 : 1);
+    GravitySimulation first;
+    GravitySimulation second;
+    addDisk(first, GRAVITY_DETERMINISM_BODIES);
+    addDisk(second, GRAVITY_DETERMINISM_BODIES);
+    for (int step = 0; step < GRAVITY_DETERMINISM_STEPS; step++) {
+        first.step(GRAVITY_BENCHMARK_STEP, jobs);
+        second.step(GRAVITY_BENCHMARK_STEP, other);
+    }
+    int differences = 0;
+    for (int body = 0; body < first.size(); body++) {
+        glm::vec3 positions[2] = {first.position(body), second.position(body)};
+        glm::vec3 velocities[2] = {first.velocity(body), second.velocity(body)};
+        if (std::memcmp(&positions[0], &positions[1], sizeof(glm::vec3)) != 0 || std::memcmp(&velocities[0], &velocities[1], sizeof(glm::vec3)) != 0)
+            differences++;
+    }
+    SDL_Log("  %d steps of %d bodies on %u and %u workers: %d bodies differ", GRAVITY_DETERMINISM_STEPS, GRAVITY_DETERMINISM_BODIES,
+        jobs.threadCount(), other.threadCount(), differences);
+
+    bool passed = differences == 0;
+    SDL_Log("Gravity benchmark %s", passed ? "passed" : "FAILED");
+    return passed;
+}
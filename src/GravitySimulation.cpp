@@ -0,0 +1,476 @@
+#include "GravitySimulation.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define GRAVITY_USE_SSE2
+#endif
+
+// Bits of the Morton code per axis, which is also the deepest tree level
+const int MORTON_LEVELS = 10;
+// Cells with this many bodies or fewer are leaves, summed body by body
+const int LEAF_SIZE = 32;
+// Levels built by the calling thread before the subtrees below go to tasks
+const int TOP_LEVELS = 2;
+// Bodies per task of the per-body passes and of the sort
+const int GRAVITY_CHUNK = 8192;
+const int RADIX_BITS = 8;
+const int RADIX_DIGITS = 1 << RADIX_BITS;
+// Deep enough for every level to leave seven siblings pending
+const int TRAVERSAL_STACK = 8 * (MORTON_LEVELS + 2);
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Spreads the low 10 bits of v to every third bit
+static uint32_t expandBits(uint32_t v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+void GravitySimulation::clear() {
+    for (std::vector<float>* values : {&positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ,
+        &accelerationX, &accelerationY, &accelerationZ, &previousX, &previousY, &previousZ, &masses}) {
+        values->clear();
+    }
+    accelerationsValid = false;
+}
+
+int GravitySimulation::add(const glm::vec3& position, const glm::vec3& velocity, float mass) {
+    int body = size();
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    velocityX.push_back(velocity.x);
+    velocityY.push_back(velocity.y);
+    velocityZ.push_back(velocity.z);
+    previousX.push_back(position.x);
+    previousY.push_back(position.y);
+    previousZ.push_back(position.z);
+    accelerationX.push_back(0.0f);
+    accelerationY.push_back(0.0f);
+    accelerationZ.push_back(0.0f);
+    masses.push_back(mass);
+    accelerationsValid = false;
+    return body;
+}
+
+void GravitySimulation::step(float dt, JobSystem& jobs) {
+    if (size() == 0)
+        return;
+    if (!accelerationsValid) {
+        buildTree(jobs);
+        computeAccelerations(jobs);
+        accelerationsValid = true;
+    }
+
+    // Kick half a step, drift a full one
+    float halfStep = 0.5f * dt;
+    jobs.parallelFor(size(), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            previousX[i] = positionX[i];
+            previousY[i] = positionY[i];
+            previousZ[i] = positionZ[i];
+            velocityX[i] += accelerationX[i] * halfStep;
+            velocityY[i] += accelerationY[i] * halfStep;
+            velocityZ[i] += accelerationZ[i] * halfStep;
+            positionX[i] += velocityX[i] * dt;
+            positionY[i] += velocityY[i] * dt;
+            positionZ[i] += velocityZ[i] * dt;
+        }
+    }, GRAVITY_CHUNK);
+
+    // Forces at the new positions, then the second half kick
+    buildTree(jobs);
+    computeAccelerations(jobs);
+    jobs.parallelFor(size(), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            velocityX[i] += accelerationX[i] * halfStep;
+            velocityY[i] += accelerationY[i] * halfStep;
+            velocityZ[i] += accelerationZ[i] * halfStep;
+        }
+    }, GRAVITY_CHUNK);
+}
+
+void GravitySimulation::buildTree(JobSystem& jobs) {
+    auto start = std::chrono::steady_clock::now();
+    int count = size();
+    int chunks = (count + GRAVITY_CHUNK - 1) / GRAVITY_CHUNK;
+
+    // Bounding cube of every body
+    chunkBounds.resize(2 * chunks);
+    jobs.parallelFor(chunks, [&](int beginChunk, int endChunk) {
+        for (int chunk = beginChunk; chunk < endChunk; chunk++) {
+            int begin = chunk * GRAVITY_CHUNK;
+            int end = std::min(begin + GRAVITY_CHUNK, count);
+            glm::vec3 low(positionX[begin], positionY[begin], positionZ[begin]);
+            glm::vec3 high = low;
+            for (int i = begin + 1; i < end; i++) {
+                low = glm::vec3(std::min(low.x, positionX[i]), std::min(low.y, positionY[i]), std::min(low.z, positionZ[i]));
+                high = glm::vec3(std::max(high.x, positionX[i]), std::max(high.y, positionY[i]), std::max(high.z, positionZ[i]));
+            }
+            chunkBounds[2 * chunk] = low;
+            chunkBounds[2 * chunk + 1] = high;
+        }
+    }, 1);
+    glm::vec3 low = chunkBounds[0];
+    glm::vec3 high = chunkBounds[1];
+    for (int chunk = 1; chunk < chunks; chunk++) {
+        low = glm::vec3(std::min(low.x, chunkBounds[2 * chunk].x), std::min(low.y, chunkBounds[2 * chunk].y), std::min(low.z, chunkBounds[2 * chunk].z));
+        high = glm::vec3(std::max(high.x, chunkBounds[2 * chunk + 1].x), std::max(high.y, chunkBounds[2 * chunk + 1].y), std::max(high.z, chunkBounds[2 * chunk + 1].z));
+    }
+    rootMin = low;
+    // Slightly larger, so the farthest bodies still quantize inside the last cell
+    rootSize = std::max({high.x - low.x, high.y - low.y, high.z - low.z, 1e-3f}) * 1.0001f;
+
+    // Morton codes, sorted together with the body indices
+    codes.resize(count);
+    order.resize(count);
+    float cellsPerUnit = static_cast<float>(1 << MORTON_LEVELS) / rootSize;
+    jobs.parallelFor(count, [&](int begin, int end) {
+        const uint32_t maxCell = (1u << MORTON_LEVELS) - 1;
+        for (int i = begin; i < end; i++) {
+            uint32_t x = std::min(static_cast<uint32_t>((positionX[i] - rootMin.x) * cellsPerUnit), maxCell);
+            uint32_t y = std::min(static_cast<uint32_t>((positionY[i] - rootMin.y) * cellsPerUnit), maxCell);
+            uint32_t z = std::min(static_cast<uint32_t>((positionZ[i] - rootMin.z) * cellsPerUnit), maxCell);
+            codes[i] = (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+            order[i] = static_cast<uint32_t>(i);
+        }
+    }, GRAVITY_CHUNK);
+    sortByMortonCode(jobs);
+
+    sortedBodies.resize(count);
+    jobs.parallelFor(count, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            uint32_t body = order[i];
+            sortedBodies[i] = glm::vec4(positionX[body], positionY[body], positionZ[body], masses[body]);
+        }
+    }, GRAVITY_CHUNK);
+
+    // Top levels here, the subtrees below them as tasks into their own arrays
+    nodes.clear();
+    nodes.emplace_back();
+    subtrees.clear();
+    buildNode(nodes, 0, 0, count, 0, &subtrees);
+    int topCount = static_cast<int>(nodes.size());
+
+    if (subtreeNodes.size() < subtrees.size())
+        subtreeNodes.resize(subtrees.size());
+    jobs.parallelFor(static_cast<int>(subtrees.size()), [&](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            std::vector<GravityNode>& local = subtreeNodes[k];
+            local.clear();
+            local.emplace_back();
+            buildNode(local, 0, subtrees[k].begin, subtrees[k].end, subtrees[k].level, nullptr);
+        }
+    }, 1);
+
+    // Append the subtrees in order. Their roots replace the placeholders of the top
+    // levels, every other node moves up by its subtree's offset.
+    int total = topCount;
+    for (size_t k = 0; k < subtrees.size(); k++) {
+        subtrees[k].offset = total - 1;
+        total += static_cast<int>(subtreeNodes[k].size()) - 1;
+    }
+    nodes.resize(total);
+    jobs.parallelFor(static_cast<int>(subtrees.size()), [&](int begin, int end) {
+        for (int k = begin; k < end; k++) {
+            const std::vector<GravityNode>& local = subtreeNodes[k];
+            for (size_t j = 0; j < local.size(); j++) {
+                GravityNode node = local[j];
+                if (node.firstChild >= 0)
+                    node.firstChild += subtrees[k].offset;
+                nodes[j == 0 ? subtrees[k].node : subtrees[k].offset + static_cast<int>(j)] = node;
+            }
+        }
+    }, 1);
+
+    // Mass of the top levels, children always come after their parent
+    for (int i = topCount - 1; i >= 0; i--) {
+        GravityNode& node = nodes[i];
+        if (node.firstChild < 0 || node.firstChild >= topCount)
+            continue;
+        node.mass = 0.0f;
+        glm::vec3 weighted(0.0f);
+        for (int c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+            node.mass += nodes[c].mass;
+            weighted += nodes[c].centerOfMass * nodes[c].mass;
+        }
+        node.centerOfMass = node.mass > 0.0f ? weighted / node.mass : nodes[node.firstChild].centerOfMass;
+    }
+
+    lastBuildSeconds = secondsSince(start);
+}
+
+void GravitySimulation::sortByMortonCode(JobSystem& jobs) {
+    // Least significant digit first radix sort. Each chunk counts its digits, the
+    // counts are turned into output positions in (digit, chunk) order and every chunk
+    // scatters its bodies in order, so the sort is stable and the same on any thread count.
+    int count = size();
+    int chunks = (count + GRAVITY_CHUNK - 1) / GRAVITY_CHUNK;
+    scratchCodes.resize(count);
+    scratchOrder.resize(count);
+    digitCounts.resize(static_cast<size_t>(chunks) * RADIX_DIGITS);
+
+    for (int shift = 0; shift < 3 * MORTON_LEVELS; shift += RADIX_BITS) {
+        std::fill(digitCounts.begin(), digitCounts.end(), 0u);
+        jobs.parallelFor(chunks, [&](int beginChunk, int endChunk) {
+            for (int chunk = beginChunk; chunk < endChunk; chunk++) {
+                uint32_t* counts = &digitCounts[static_cast<size_t>(chunk) * RADIX_DIGITS];
+                int end = std::min((chunk + 1) * GRAVITY_CHUNK, count);
+                for (int i = chunk * GRAVITY_CHUNK; i < end; i++) {
+                    counts[(codes[i] >> shift) & (RADIX_DIGITS - 1)]++;
+                }
+            }
+        }, 1);
+
+        uint32_t position = 0;
+        for (int digit = 0; digit < RADIX_DIGITS; digit++) {
+            for (int chunk = 0; chunk < chunks; chunk++) {
+                uint32_t& slot = digitCounts[static_cast<size_t>(chunk) * RADIX_DIGITS + digit];
+                uint32_t digitCount = slot;
+                slot = position;
+                position += digitCount;
+            }
+        }
+
+        jobs.parallelFor(chunks, [&](int beginChunk, int endChunk) {
+            for (int chunk = beginChunk; chunk < endChunk; chunk++) {
+                uint32_t* next = &digitCounts[static_cast<size_t>(chunk) * RADIX_DIGITS];
+                int end = std::min((chunk + 1) * GRAVITY_CHUNK, count);
+                for (int i = chunk * GRAVITY_CHUNK; i < end; i++) {
+                    uint32_t slot = next[(codes[i] >> shift) & (RADIX_DIGITS - 1)]++;
+                    scratchCodes[slot] = codes[i];
+                    scratchOrder[slot] = order[i];
+                }
+            }
+        }, 1);
+        codes.swap(scratchCodes);
+        order.swap(scratchOrder);
+    }
+}
+
+void GravitySimulation::buildNode(std::vector<GravityNode>& out, int index, int begin, int end, int level, std::vector<Subtree>* deferred) const {
+    GravityNode node;
+    node.firstBody = begin;
+    node.bodyCount = end - begin;
+    node.size = rootSize / static_cast<float>(1 << level);
+
+    if (node.bodyCount <= LEAF_SIZE || level == MORTON_LEVELS) {
+        glm::vec3 weighted(0.0f);
+        glm::vec3 sum(0.0f);
+        for (int i = begin; i < end; i++) {
+            node.mass += sortedBodies[i].w;
+            weighted += glm::vec3(sortedBodies[i]) * sortedBodies[i].w;
+            sum += glm::vec3(sortedBodies[i]);
+        }
+        // Massless bodies still need a position
+        node.centerOfMass = node.mass > 0.0f ? weighted / node.mass : sum / static_cast<float>(node.bodyCount);
+        out[index] = node;
+        return;
+    }
+
+    if (deferred && level == TOP_LEVELS) {
+        out[index] = node;
+        deferred->push_back(Subtree{index, begin, end, level});
+        return;
+    }
+
+    // The bodies of each octant are a run of the sorted codes
+    int shift = 3 * (MORTON_LEVELS - 1 - level);
+    int bounds[9];
+    bounds[0] = begin;
+    for (int octant = 0; octant < 8; octant++) {
+        const uint32_t* first = codes.data() + bounds[octant];
+        const uint32_t* last = codes.data() + end;
+        bounds[octant + 1] = static_cast<int>(std::partition_point(first, last, [&](uint32_t code) { return static_cast<int>((code >> shift) & 7) <= octant; }) - codes.data());
+    }
+
+    node.firstChild = static_cast<int>(out.size());
+    for (int octant = 0; octant < 8; octant++) {
+        if (bounds[octant + 1] > bounds[octant])
+            node.childCount++;
+    }
+    out.resize(out.size() + node.childCount);
+
+    // out may reallocate while the children are built, so node is only stored at the end
+    int child = node.firstChild;
+    for (int octant = 0; octant < 8; octant++) {
+        if (bounds[octant + 1] > bounds[octant])
+            buildNode(out, child++, bounds[octant], bounds[octant + 1], level + 1, deferred);
+    }
+
+    glm::vec3 weighted(0.0f);
+    for (int c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+        node.mass += out[c].mass;
+        weighted += out[c].centerOfMass * out[c].mass;
+    }
+    node.centerOfMass = node.mass > 0.0f ? weighted / node.mass : out[node.firstChild].centerOfMass;
+    out[index] = node;
+}
+
+// Interaction list of one leaf: cells far enough away to act as one body, then the
+// bodies of the leaves that had to be opened, padded to the SIMD width with massless
+// entries. One list serves every body of the leaf.
+struct InteractionList {
+    std::vector<float> x, y, z, mass;
+
+    void clear() {
+        x.clear();
+        y.clear();
+        z.clear();
+        mass.clear();
+    }
+    void add(const glm::vec3& position, float bodyMass) {
+        x.push_back(position.x);
+        y.push_back(position.y);
+        z.push_back(position.z);
+        mass.push_back(bodyMass);
+    }
+    void pad() {
+        while (mass.size() % 8 != 0) {
+            add(glm::vec3(0.0f), 0.0f);
+        }
+    }
+    int size() const { return static_cast<int>(mass.size()); }
+};
+
+// Reused by every leaf a worker handles, so lists only allocate while they grow
+static thread_local InteractionList interactions;
+
+// Softened pull of every list entry on a body at position. An entry at the body's own
+// position adds nothing, so a leaf's list can include its own bodies.
+static glm::vec3 sumInteractions(const InteractionList& list, const glm::vec3& position, float softening2) {
+    int i = 0;
+    glm::vec3 acceleration(0.0f);
+#if defined(__AVX2__)
+    const __m256 px = _mm256_set1_ps(position.x);
+    const __m256 py = _mm256_set1_ps(position.y);
+    const __m256 pz = _mm256_set1_ps(position.z);
+    const __m256 eps = _mm256_set1_ps(softening2);
+    __m256 ax = _mm256_setzero_ps();
+    __m256 ay = _mm256_setzero_ps();
+    __m256 az = _mm256_setzero_ps();
+    for (; i + 8 <= list.size(); i += 8) {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&list.x[i]), px);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&list.y[i]), py);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&list.z[i]), pz);
+        __m256 distance2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_add_ps(_mm256_mul_ps(dz, dz), eps));
+        __m256 strength = _mm256_div_ps(_mm256_loadu_ps(&list.mass[i]), _mm256_mul_ps(distance2, _mm256_sqrt_ps(distance2)));
+        ax = _mm256_add_ps(ax, _mm256_mul_ps(dx, strength));
+        ay = _mm256_add_ps(ay, _mm256_mul_ps(dy, strength));
+        az = _mm256_add_ps(az, _mm256_mul_ps(dz, strength));
+    }
+    alignas(32) float lanes[3][8];
+    _mm256_store_ps(lanes[0], ax);
+    _mm256_store_ps(lanes[1], ay);
+    _mm256_store_ps(lanes[2], az);
+    for (int lane = 0; lane < 8; lane++) {
+        acceleration += glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+    }
+#elif defined(GRAVITY_USE_SSE2)
+    const __m128 px = _mm_set1_ps(position.x);
+    const __m128 py = _mm_set1_ps(position.y);
+    const __m128 pz = _mm_set1_ps(position.z);
+    const __m128 eps = _mm_set1_ps(softening2);
+    __m128 ax = _mm_setzero_ps();
+    __m128 ay = _mm_setzero_ps();
+    __m128 az = _mm_setzero_ps();
+    for (; i + 4 <= list.size(); i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&list.x[i]), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&list.y[i]), py);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&list.z[i]), pz);
+        __m128 distance2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_add_ps(_mm_mul_ps(dz, dz), eps));
+        __m128 strength = _mm_div_ps(_mm_loadu_ps(&list.mass[i]), _mm_mul_ps(distance2, _mm_sqrt_ps(distance2)));
+        ax = _mm_add_ps(ax, _mm_mul_ps(dx, strength));
+        ay = _mm_add_ps(ay, _mm_mul_ps(dy, strength));
+        az = _mm_add_ps(az, _mm_mul_ps(dz, strength));
+    }
+    alignas(16) float lanes[3][4];
+    _mm_store_ps(lanes[0], ax);
+    _mm_store_ps(lanes[1], ay);
+    _mm_store_ps(lanes[2], az);
+    for (int lane = 0; lane < 4; lane++) {
+        acceleration += glm::vec3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+    }
+#endif
+    for (; i < list.size(); i++) {
+        glm::vec3 delta = glm::vec3(list.x[i], list.y[i], list.z[i]) - position;
+        float distance2 = glm::dot(delta, delta) + softening2;
+        acceleration += delta * (list.mass[i] / (distance2 * std::sqrt(distance2)));
+    }
+    return acceleration;
+}
+
+void GravitySimulation::computeAccelerations(JobSystem& jobs) {
+    auto start = std::chrono::steady_clock::now();
+    const float softening2 = softening * softening;
+
+    leaves.clear();
+    for (int i = 0; i < nodeCount(); i++) {
+        if (nodes[i].firstChild < 0)
+            leaves.push_back(i);
+    }
+
+    // The tree is walked once per leaf rather than once per body. A cell acts as one
+    // body when it is far enough from the leaf's whole bounding sphere.
+    jobs.parallelFor(static_cast<int>(leaves.size()), [&](int begin, int end) {
+        int stack[TRAVERSAL_STACK];
+        for (int l = begin; l < end; l++) {
+            const GravityNode& leaf = nodes[leaves[l]];
+            glm::vec3 low(sortedBodies[leaf.firstBody]);
+            glm::vec3 high = low;
+            for (int s = leaf.firstBody + 1; s < leaf.firstBody + leaf.bodyCount; s++) {
+                low = glm::vec3(std::min(low.x, sortedBodies[s].x), std::min(low.y, sortedBodies[s].y), std::min(low.z, sortedBodies[s].z));
+                high = glm::vec3(std::max(high.x, sortedBodies[s].x), std::max(high.y, sortedBodies[s].y), std::max(high.z, sortedBodies[s].z));
+            }
+            glm::vec3 center = (low + high) * 0.5f;
+            float radius = glm::length(high - center);
+
+            interactions.clear();
+            int top = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const GravityNode& node = nodes[stack[--top]];
+                bool containsLeaf = leaf.firstBody >= node.firstBody && leaf.firstBody < node.firstBody + node.bodyCount;
+                if (!containsLeaf) {
+                    float distance = glm::length(node.centerOfMass - center) - radius;
+                    if (distance > 0.0f && node.size < theta * distance) {
+                        interactions.add(node.centerOfMass, node.mass);
+                        continue;
+                    }
+                }
+                if (node.firstChild < 0) {
+                    for (int j = node.firstBody; j < node.firstBody + node.bodyCount; j++) {
+                        interactions.add(glm::vec3(sortedBodies[j]), sortedBodies[j].w);
+                    }
+                    continue;
+                }
+                for (int c = node.firstChild + node.childCount - 1; c >= node.firstChild; c--) {
+                    stack[top++] = c;
+                }
+            }
+            interactions.pad();
+
+            for (int s = leaf.firstBody; s < leaf.firstBody + leaf.bodyCount; s++) {
+                glm::vec3 acceleration = sumInteractions(interactions, glm::vec3(sortedBodies[s]), softening2) * gravitationalConstant;
+                uint32_t body = order[s];
+                accelerationX[body] = acceleration.x;
+                accelerationY[body] = acceleration.y;
+                accelerationZ[body] = acceleration.z;
+            }
+        }
+    }, 16);
+
+    lastForceSeconds = secondsSince(start);
+}
@@ -0,0 +1,85 @@
+#include "HdrBuffer.h"
+#include "JobSystem.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Reinhard extended per channel, then sqrt as the gamma curve
+static inline Uint8 toneMapChannel(float value, float exposure, float invWhite2) {
+    // Negative and NaN inputs become black, anything past the white point full white
+    float x = std::max(0.0f, value * exposure);
+    float mapped = x * (1.0f + x * invWhite2) / (1.0f + x);
+    float encoded = std::sqrt(std::min(1.0f, mapped));
+    return static_cast<Uint8>(encoded * 255.0f + 0.5f);
+}
+
+#if defined(__AVX2__)
+static inline __m256i toneMapLanes(__m256 value, __m256 exposure, __m256 invWhite2) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    // Operand order matches the scalar path: max/min return the second operand for NaN
+    __m256 x = _mm256_max_ps(_mm256_mul_ps(value, exposure), _mm256_setzero_ps());
+    __m256 mapped = _mm256_div_ps(_mm256_mul_ps(x, _mm256_add_ps(one, _mm256_mul_ps(x, invWhite2))), _mm256_add_ps(x, one));
+    __m256 encoded = _mm256_sqrt_ps(_mm256_min_ps(mapped, one));
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(encoded, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+#elif defined(COLOR_USE_SSE2)
+static inline __m128i toneMapLanes(__m128 value, __m128 exposure, __m128 invWhite2) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 x = _mm_max_ps(_mm_mul_ps(value, exposure), _mm_setzero_ps());
+    __m128 mapped = _mm_div_ps(_mm_mul_ps(x, _mm_add_ps(one, _mm_mul_ps(x, invWhite2))), _mm_add_ps(x, one));
+    __m128 encoded = _mm_sqrt_ps(_mm_min_ps(mapped, one));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(encoded, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+#endif
+
+void resolveHdrRows(const HdrBuffer& hdr, const ToneMapSettings& settings, Uint32* output, int outputStride, int yBegin, int yEnd) {
+    const float invWhite2 = 1.0f / (settings.whitePoint * settings.whitePoint);
+
+    for (int y = yBegin; y < yEnd; y++) {
+        const float* red = hdr.red.data() + y * hdr.width;
+        const float* green = hdr.green.data() + y * hdr.width;
+        const float* blue = hdr.blue.data() + y * hdr.width;
+        Uint32* row = output + y * outputStride;
+        int x = 0;
+
+#if defined(__AVX2__)
+        const __m256 exposure = _mm256_set1_ps(settings.exposure);
+        const __m256 white = _mm256_set1_ps(invWhite2);
+        const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        for (; x + 8 <= hdr.width; x += 8) {
+            __m256i r = toneMapLanes(_mm256_loadu_ps(red + x), exposure, white);
+            __m256i g = toneMapLanes(_mm256_loadu_ps(green + x), exposure, white);
+            __m256i b = toneMapLanes(_mm256_loadu_ps(blue + x), exposure, white);
+            __m256i argb = _mm256_or_si256(_mm256_or_si256(opaque, _mm256_slli_epi32(r, 16)), _mm256_or_si256(_mm256_slli_epi32(g, 8), b));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x), argb);
+        }
+#elif defined(COLOR_USE_SSE2)
+        const __m128 exposure = _mm_set1_ps(settings.exposure);
+        const __m128 white = _mm_set1_ps(invWhite2);
+        const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        for (; x + 4 <= hdr.width; x += 4) {
+            __m128i r = toneMapLanes(_mm_loadu_ps(red + x), exposure, white);
+            __m128i g = toneMapLanes(_mm_loadu_ps(green + x), exposure, white);
+            __m128i b = toneMapLanes(_mm_loadu_ps(blue + x), exposure, white);
+            __m128i argb = _mm_or_si128(_mm_or_si128(opaque, _mm_slli_epi32(r, 16)), _mm_or_si128(_mm_slli_epi32(g, 8), b));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), argb);
+        }
+#endif
+
+        for (; x < hdr.width; x++) {
+            row[x] = 0xFF000000u |
+                (static_cast<Uint32>(toneMapChannel(red[x], settings.exposure, invWhite2)) << 16) |
+                (static_cast<Uint32>(toneMapChannel(green[x], settings.exposure, invWhite2)) << 8) |
+                static_cast<Uint32>(toneMapChannel(blue[x], settings.exposure, invWhite2));
+        }
+    }
+}
+
+void resolveHdr(const HdrBuffer& hdr, const ToneMapSettings& settings, Uint32* output, int outputStride, JobSystem& jobs) {
+    jobs.parallelFor(hdr.height, [&](int begin, int end) {
+        resolveHdrRows(hdr, settings, output, outputStride, begin, end);
+    });
+}
@@ -0,0 +1,110 @@
+#include "HiZBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// The rasterizer drops pixels whose normal turns away from the view direction, which
+// near the silhouette of a sphere off to the side of the screen can leave holes. Only
+// the inner part of a sphere's disc counts as covered, where normals face the camera.
+const float OCCLUDER_DISC_SCALE = 0.7f;
+
+HiZBuffer::HiZBuffer(int width, int height) : width(width), height(height) {
+    int levelWidth = (width + HIZ_TILE - 1) / HIZ_TILE;
+    int levelHeight = (height + HIZ_TILE - 1) / HIZ_TILE;
+    while (true) {
+        levels.push_back(Level{levelWidth, levelHeight, std::vector<float>(levelWidth * levelHeight)});
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+    clear();
+}
+
+void HiZBuffer::clear() {
+    for (Level& level : levels) {
+        std::fill(level.depths.begin(), level.depths.end(), std::numeric_limits<float>::infinity());
+    }
+    occluders = 0;
+}
+
+void HiZBuffer::addSphere(const glm::vec3& center, float radius, const glm::mat4& view, const glm::mat4& projection, const glm::mat4& viewport) {
+    // The disc where the sphere cuts the plane through its center facing the camera lies
+    // inside the sphere, so whatever is behind that plane and within the disc is hidden.
+    // At constant depth it projects to an exact circle, also off the screen's center.
+    glm::vec4 viewCenter = view * glm::vec4(center, 1.0f);
+    float depth = -viewCenter.z;
+    if (depth <= radius)
+        return;
+    glm::vec2 ndc(projection[0][0] * viewCenter.x / depth, projection[1][1] * viewCenter.y / depth);
+    glm::vec2 screen(viewport[0][0] * ndc.x + viewport[3][0], viewport[1][1] * ndc.y + viewport[3][1]);
+    float screenRadius = OCCLUDER_DISC_SCALE * radius * projection[1][1] * viewport[1][1] / depth;
+
+    // Tiles whose farthest corner is inside the disc
+    Level& level = levels[0];
+    int minX = std::max(0, static_cast<int>((screen.x - screenRadius) / HIZ_TILE));
+    int maxX = std::min(level.width - 1, static_cast<int>((screen.x + screenRadius) / HIZ_TILE));
+    int minY = std::max(0, static_cast<int>((screen.y - screenRadius) / HIZ_TILE));
+    int maxY = std::min(level.height - 1, static_cast<int>((screen.y + screenRadius) / HIZ_TILE));
+    float radius2 = screenRadius * screenRadius;
+    bool covered = false;
+    for (int y = minY; y <= maxY; y++) {
+        float dy = std::max(std::abs(y * HIZ_TILE - screen.y), std::abs((y + 1) * HIZ_TILE - screen.y));
+        for (int x = minX; x <= maxX; x++) {
+            float dx = std::max(std::abs(x * HIZ_TILE - screen.x), std::abs((x + 1) * HIZ_TILE - screen.x));
+            if (dx * dx + dy * dy > radius2)
+                continue;
+            float& texel = level.depths[y * level.width + x];
+            texel = std::min(texel, depth);
+            covered = true;
+        }
+    }
+    if (covered)
+        occluders++;
+}
+
+void HiZBuffer::buildPyramid() {
+    for (size_t i = 1; i < levels.size(); i++) {
+        const Level& below = levels[i - 1];
+        Level& level = levels[i];
+        for (int y = 0; y < level.height; y++) {
+            for (int x = 0; x < level.width; x++) {
+                // Texels past the edge of the level below cover no pixel
+                int x1 = std::min(2 * x + 1, below.width - 1);
+                int y1 = std::min(2 * y + 1, below.height - 1);
+                float depth = std::max(
+                    std::max(below.depths[2 * y * below.width + 2 * x], below.depths[2 * y * below.width + x1]),
+                    std::max(below.depths[y1 * below.width + 2 * x], below.depths[y1 * below.width + x1]));
+                level.depths[y * level.width + x] = depth;
+            }
+        }
+    }
+}
+
+bool HiZBuffer::occluded(const glm::vec2& min, const glm::vec2& max, float depth) const {
+    if (occluders == 0)
+        return false;
+    int minX = std::max(0, static_cast<int>(min.x));
+    int minY = std::max(0, static_cast<int>(min.y));
+    int maxX = std::min(width - 1, static_cast<int>(max.x));
+    int maxY = std::min(height - 1, static_cast<int>(max.y));
+    if (minX > maxX || minY > maxY)
+        return false;
+
+    // The lowest level at which the rectangle spans at most 2x2 texels
+    int size = std::max(maxX - minX, maxY - minY) + 1;
+    int index = 0;
+    while (index + 1 < static_cast<int>(levels.size()) && (HIZ_TILE << index) < size) {
+        index++;
+    }
+    const Level& level = levels[index];
+    int tile = HIZ_TILE << index;
+    for (int y = minY / tile; y <= maxY / tile; y++) {
+        for (int x = minX / tile; x <= maxX / tile; x++) {
+            if (depth <= level.depths[y * level.width + x])
+                return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,331 @@
+#include "JobSystem.h"
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <chrono>
+
+// Worker index of the calling thread, -1 outside the pool
+static thread_local int currentWorker = -1;
+static thread_local const JobSystem* currentSystem = nullptr;
+// Nesting of tasks on this thread, only the outermost one counts as busy time
+static thread_local int executeDepth = 0;
+
+static int64_t nowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Job {
+public:
+    JobSystem* system = nullptr;
+    std::function<void()> task;
+    std::atomic<int> pendingDependencies{1};    // Held at 1 by submit() until the dependencies are registered
+    std::mutex mutex;
+    std::atomic<bool> finished{false};
+    bool released = false;                      // Dependents were taken to be scheduled, guarded by mutex
+    std::vector<JobHandle> dependents;
+    JobHandle self;                             // Keeps the job alive while it is queued
+};
+
+bool JobSystem::TaskQueue::pushBack(const Task& task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == CAPACITY)
+        return false;
+    tasks[(head + size) % CAPACITY] = task;
+    size++;
+    return true;
+}
+
+bool JobSystem::TaskQueue::popBack(Task& task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == 0)
+        return false;
+    size--;
+    task = tasks[(head + size) % CAPACITY];
+    return true;
+}
+
+bool JobSystem::TaskQueue::popFront(Task& task) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (size == 0)
+        return false;
+    task = tasks[head];
+    head = (head + 1) % CAPACITY;
+    size--;
+    return true;
+}
+
+JobSystem::JobSystem(unsigned threadCount) {
+    // hardware_concurrency() may report 0, there is always at least one worker
+    int count = std::clamp(static_cast<int>(threadCount), 1, MAX_JOB_WORKERS);
+    for (int i = 0; i < count; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    countersStart = nowNanoseconds();
+    for (int i = 0; i < count; i++) {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void JobSystem::workerLoop(int index) {
+    currentWorker = index;
+    currentSystem = this;
+    workers[index]->heapAllocations = threadHeapAllocationCounter();
+
+    while (!stopping) {
+        if (tryRunTask(true))
+            continue;
+
+        // Spin briefly before sleeping, work usually arrives in bursts
+        bool found = false;
+        for (int spin = 0; spin < 64 && !found; spin++) {
+            std::this_thread::yield();
+            found = queuedTasks > 0;
+        }
+        if (found)
+            continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers++;
+        wake.wait(lock, [this] { return queuedTasks > 0 || stopping; });
+        sleepingWorkers--;
+    }
+}
+
+void JobSystem::enqueue(const Task& task, bool job) {
+    int self = workerIndex();
+
+    // Jobs always go to the shared queue, from any thread, so only idle workers start
+    // them. The deques hold parallelFor chunks alone: a worker keeps its own, chunks
+    // queued from outside are dealt to the workers round robin.
+    bool queued;
+    if (job)
+        queued = injected.pushBack(task);
+    else if (self >= 0)
+        queued = workers[self]->queue.pushBack(task);
+    else
+        queued = workers[nextWorker++ % workers.size()]->queue.pushBack(task);
+
+    if (!queued) {
+        execute(task, self);
+        return;
+    }
+
+    queuedTasks++;
+    if (sleepingWorkers > 0) {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+}
+
+bool JobSystem::tryRunTask(bool takeJobs) {
+    int self = workerIndex();
+    Task task;
+
+    if (self >= 0 && workers[self]->queue.popBack(task)) {
+        queuedTasks--;
+        execute(task, self);
+        return true;
+    }
+
+    // Only idle workers take jobs. A thread waiting on a parallelFor or a job only runs
+    // and steals parallelFor chunks, so it never ends up inside an unrelated long job
+    // such as an asset load or the next frame's render.
+    if (takeJobs && self >= 0 && injected.popFront(task)) {
+        queuedTasks--;
+        execute(task, self);
+        return true;
+    }
+
+    int count = static_cast<int>(workers.size());
+    int start = self >= 0 ? self + 1 : static_cast<int>(nextWorker % count);
+    for (int i = 0; i < count; i++) {
+        int victim = (start + i) % count;
+        if (victim == self)
+            continue;
+        if (workers[victim]->queue.popFront(task)) {
+            queuedTasks--;
+            if (self >= 0)
+                workers[self]->steals.fetch_add(1, std::memory_order_relaxed);
+            execute(task, self);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(const Task& task, int worker) {
+    if (worker < 0 || executeDepth > 0) {
+        executeDepth++;
+        task.run(task.context, task.index);
+        executeDepth--;
+    } else {
+        int64_t start = nowNanoseconds();
+        executeDepth++;
+        task.run(task.context, task.index);
+        executeDepth--;
+        workers[worker]->busyNanoseconds.fetch_add(nowNanoseconds() - start, std::memory_order_relaxed);
+    }
+    if (worker >= 0)
+        workers[worker]->tasks.fetch_add(1, std::memory_order_relaxed);
+    outstandingTasks--;
+}
+
+int JobSystem::workerIndex() const {
+    return currentSystem == this ? currentWorker : -1;
+}
+
+void JobSystem::parallelForRange(int count, RangeFunction run, const void* body, int grain) {
+    if (count <= 0)
+        return;
+
+    int targetChunks = static_cast<int>(threadCount()) * 4;
+    int chunkSize = grain > 0 ? grain : std::max(1, (count + targetChunks - 1) / targetChunks);
+    int chunks = (count + chunkSize - 1) / chunkSize;
+    if (chunks == 1) {
+        run(body, 0, count);
+        return;
+    }
+
+    struct ForState {
+        RangeFunction run;
+        const void* body;
+        int count;
+        int chunkSize;
+        std::atomic<int> remaining;
+    };
+    ForState state{run, body, count, chunkSize, chunks};
+
+    auto runChunk = [](void* context, int chunk) {
+        ForState* state = static_cast<ForState*>(context);
+        int begin = chunk * state->chunkSize;
+        int end = std::min(begin + state->chunkSize, state->count);
+        state->run(state->body, begin, end);
+        state->remaining.fetch_sub(1, std::memory_order_release);
+    };
+
+    // The caller takes chunk 0 and then helps with whatever is queued until all chunks ran
+    outstandingTasks += chunks - 1;
+    for (int chunk = chunks - 1; chunk >= 1; chunk--) {
+        enqueue(Task{runChunk, &state, chunk}, false);
+    }
+    runChunk(&state, 0);
+
+    while (state.remaining.load(std::memory_order_acquire) > 0) {
+        if (!tryRunTask(false))
+            std::this_thread::yield();
+    }
+}
+
+JobHandle JobSystem::submit(std::function<void()> task, std::initializer_list<JobHandle> dependencies) {
+    JobHandle job;
+    submit(job, std::move(task), dependencies);
+    return job;
+}
+
+void JobSystem::submit(JobHandle& job, std::function<void()> task, std::initializer_list<JobHandle> dependencies) {
+    if (job) {
+        wait(job);
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished = false;
+        job->released = false;
+        job->pendingDependencies = 1;
+    } else {
+        job = std::make_shared<Job>();
+        job->system = this;
+    }
+    job->task = std::move(task);
+    outstandingTasks++;
+
+    for (const JobHandle& dependency : dependencies) {
+        if (!dependency)
+            continue;
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (!dependency->released) {
+            dependency->dependents.push_back(job);
+            job->pendingDependencies++;
+        }
+    }
+
+    if (--job->pendingDependencies == 0)
+        schedule(job);
+}
+
+void JobSystem::schedule(const JobHandle& job) {
+    job->self = job;
+    enqueue(Task{runJob, job.get(), 0}, true);
+}
+
+void JobSystem::runJob(void* context, int) {
+    Job* job = static_cast<Job*>(context);
+    JobHandle keepAlive = std::move(job->self);
+    job->task();
+
+    // From here on new dependents don't wait. The job only counts as done once its
+    // dependents are scheduled and their list, emptied, is back for the job's reuse.
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->released = true;
+        dependents.swap(job->dependents);
+    }
+    for (const JobHandle& dependent : dependents) {
+        if (--dependent->pendingDependencies == 0)
+            job->system->schedule(dependent);
+    }
+    dependents.clear();
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->dependents.swap(dependents);
+    }
+    job->finished = true;
+}
+
+bool JobSystem::isDone(const JobHandle& job) const {
+    return !job || job->finished;
+}
+
+void JobSystem::wait(const JobHandle& job) {
+    while (!isDone(job)) {
+        if (!tryRunTask(false))
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::waitIdle() {
+    while (outstandingTasks > 0) {
+        if (!tryRunTask(false))
+            std::this_thread::yield();
+    }
+}
+
+uint64_t JobSystem::takeCounters(WorkerCounters* out) {
+    for (size_t i = 0; i < workers.size(); i++) {
+        out[i].tasks = workers[i]->tasks.exchange(0, std::memory_order_relaxed);
+        out[i].steals = workers[i]->steals.exchange(0, std::memory_order_relaxed);
+        out[i].busyNanoseconds = workers[i]->busyNanoseconds.exchange(0, std::memory_order_relaxed);
+    }
+    int64_t now = nowNanoseconds();
+    return static_cast<uint64_t>(now - countersStart.exchange(now));
+}
+
+uint64_t JobSystem::heapAllocationCount() const {
+    uint64_t allocations = 0;
+    for (const std::unique_ptr<Worker>& worker : workers) {
+        if (const std::atomic<uint64_t>* counter = worker->heapAllocations.load())
+            allocations += counter->load(std::memory_order_relaxed);
+    }
+    return allocations;
+}
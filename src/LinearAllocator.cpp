@@ -0,0 +1,75 @@
+#include "LinearAllocator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+LinearAllocator::LinearAllocator(size_t initialBytes) {
+    chunks.push_back(Chunk{std::make_unique<std::byte[]>(initialBytes), initialBytes});
+}
+
+void* LinearAllocator::do_allocate(size_t bytes, size_t alignment) {
+    while (true) {
+        Chunk& chunk = chunks[current];
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunk.memory.get());
+        size_t aligned = ((base + offset + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+        if (aligned + bytes <= chunk.size) {
+            offset = aligned + bytes;
+            used += bytes;
+            return chunk.memory.get() + aligned;
+        }
+
+        // Move on to the next chunk, adding one that fits if this was the last
+        current++;
+        offset = 0;
+        if (current == chunks.size()) {
+            size_t size = std::max(chunk.size * 2, bytes + alignment);
+            chunks.push_back(Chunk{std::make_unique<std::byte[]>(size), size});
+        }
+    }
+}
+
+void LinearAllocator::reset() {
+    // Spilled into more chunks this frame, replace them with one that holds everything
+    if (current > 0) {
+        size_t size = capacity();
+        chunks.clear();
+        chunks.push_back(Chunk{std::make_unique<std::byte[]>(size), size});
+    }
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+size_t LinearAllocator::capacity() const {
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) {
+        total += chunk.size;
+    }
+    return total;
+}
+
+FrameArena::FrameArena(JobSystem& jobs) : jobs(jobs) {
+    for (unsigned i = 0; i <= jobs.threadCount(); i++) {
+        allocators.push_back(std::make_unique<LinearAllocator>());
+    }
+}
+
+LinearAllocator& FrameArena::local() {
+    // Threads outside the pool share the last allocator, only the frame's owner uses it
+    int worker = jobs.workerIndex();
+    return *allocators[worker >= 0 ? worker : allocators.size() - 1];
+}
+
+void FrameArena::reset() {
+    for (std::unique_ptr<LinearAllocator>& allocator : allocators) {
+        allocator->reset();
+    }
+}
+
+size_t FrameArena::bytesUsed() const {
+    size_t total = 0;
+    for (const std::unique_ptr<LinearAllocator>& allocator : allocators) {
+        total += allocator->bytesUsed();
+    }
+    return total;
+}
@@ -0,0 +1,96 @@
+#include "MeshRegistry.h"
+
+#include "ObjLoader.h"
+#include "RenderingUtils.h"
+
+#include <algorithm>
+#include <cmath>
+
+MeshHandle MeshRegistry::load(const std::string& path) {
+    if (MeshHandle mesh = find(path))
+        return mesh;
+
+    // Parse outside the lock so different files load in parallel
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    std::vector<Face> faces;
+    if (!loadOBJ(path.c_str(), vertices, normals, faces))
+        return nullptr;
+    return add(path, setupVertexBufferObject(vertices, normals, faces));
+}
+
+// The compressed vertices if they stay within the error bounds, with 32-bit normals
+// when 16-bit ones are too coarse. Empty if the vertices should stay floats.
+static QuantizedVertices compressVertices(const std::vector<glm::vec3>& vertexBufferObject, float boundingRadius, const VertexCompression& compression) {
+    if (!compression.enabled)
+        return {};
+    for (int normalBits = compression.normalBits; normalBits <= 32; normalBits += 16) {
+        QuantizedVertices quantized = quantizeVertices(vertexBufferObject, normalBits);
+        // More normal bits won't help the positions
+        if (quantized.positionError > compression.maxPositionError * boundingRadius)
+            return {};
+        if (quantized.normalError <= compression.maxNormalError)
+            return quantized;
+    }
+    return {};
+}
+
+// Meshlet bounds were taken from the float vertices, grown so they still hold the
+// decoded ones and culling stays conservative
+static void widenMeshlets(std::vector<Meshlet>& meshlets, float positionError, float normalError) {
+    for (Meshlet& meshlet : meshlets) {
+        meshlet.radius += positionError;
+        if (meshlet.coneCutoff > 0.0f)
+            meshlet.coneCutoff = std::cos(std::acos(meshlet.coneCutoff) + normalError);
+    }
+}
+
+MeshHandle MeshRegistry::add(const std::string& name, std::vector<glm::vec3> vertexBufferObject) {
+    // Outside the lock like the parsing, at worst wasted if another thread wins
+    std::vector<Meshlet> meshlets = buildMeshlets(vertexBufferObject);
+    float boundingRadius = 0.0f;
+    for (size_t i = 0; i < vertexBufferObject.size(); i += 2) {
+        boundingRadius = std::max(boundingRadius, glm::length(vertexBufferObject[i]));
+    }
+    QuantizedVertices quantized = compressVertices(vertexBufferObject, boundingRadius, compression);
+    if (!quantized.empty()) {
+        widenMeshlets(meshlets, quantized.positionError, quantized.normalError);
+        boundingRadius += quantized.positionError;
+        vertexBufferObject = {};
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::weak_ptr<const Mesh>& entry = meshes[name];
+    // Another thread may have registered it first
+    if (MeshHandle mesh = entry.lock())
+        return mesh;
+
+    MeshHandle mesh = std::make_shared<const Mesh>(Mesh{name, std::move(vertexBufferObject), std::move(quantized), std::move(meshlets), boundingRadius});
+    entry = mesh;
+    return mesh;
+}
+
+MeshHandle MeshRegistry::find(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto entry = meshes.find(name);
+    return entry != meshes.end() ? entry->second.lock() : nullptr;
+}
+
+MeshRegistryStats MeshRegistry::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    MeshRegistryStats stats;
+    for (const auto& [name, entry] : meshes) {
+        MeshHandle mesh = entry.lock();
+        if (!mesh)
+            continue;
+        // Not counting the handle held here
+        size_t handles = static_cast<size_t>(mesh.use_count()) - 1;
+        stats.meshes++;
+        stats.handles += handles;
+        stats.bytes += mesh->bytes();
+        stats.uncompressedBytes += mesh->uncompressedBytes();
+        stats.quantizedMeshes += mesh->quantized.empty() ? 0 : 1;
+        stats.copiedBytes += mesh->bytes() * handles;
+    }
+    return stats;
+}
@@ -0,0 +1,153 @@
+#include "Meshlet.h"
+#include "HiZBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+// Spreads the low 10 bits of v out to every third bit
+static uint32_t spreadBits(uint32_t v) {
+    v &= 0x3FF;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// Which of the six axis directions a normal is closest to
+static uint32_t normalFace(const glm::vec3& normal) {
+    glm::vec3 size(std::abs(normal.x), std::abs(normal.y), std::abs(normal.z));
+    int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+    return 2 * axis + (normal[axis] < 0.0f ? 1 : 0);
+}
+
+std::vector<Meshlet> buildMeshlets(std::vector<glm::vec3>& vertexBufferObject) {
+    int triangleCount = static_cast<int>(vertexBufferObject.size() / 6);
+    std::vector<Meshlet> meshlets;
+    if (triangleCount == 0)
+        return meshlets;
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (size_t v = 0; v < vertexBufferObject.size(); v += 2) {
+        boundsMin = glm::min(boundsMin, vertexBufferObject[v]);
+        boundsMax = glm::max(boundsMax, vertexBufferObject[v]);
+    }
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+
+    // Triangles grouped by the direction they face, then along a Morton curve through
+    // their centroids, so consecutive runs are compact and their normal cones narrow
+    std::vector<uint64_t> keys(triangleCount);
+    for (int t = 0; t < triangleCount; t++) {
+        const glm::vec3* vertices = &vertexBufferObject[6 * t];
+        glm::vec3 centroid = (vertices[0] + vertices[2] + vertices[4]) / 3.0f;
+        glm::vec3 normal = vertices[1] + vertices[3] + vertices[5];
+        glm::vec3 cell = (centroid - boundsMin) / extent * 1023.0f;
+        uint32_t morton = spreadBits(static_cast<uint32_t>(cell.x)) | spreadBits(static_cast<uint32_t>(cell.y)) << 1 | spreadBits(static_cast<uint32_t>(cell.z)) << 2;
+        keys[t] = static_cast<uint64_t>(normalFace(normal)) << 30 | morton;
+    }
+    std::vector<int> order(triangleCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return keys[a] < keys[b]; });
+
+    std::vector<glm::vec3> sorted;
+    sorted.reserve(vertexBufferObject.size());
+    for (int t = 0; t < triangleCount; t++) {
+        int source = order[t];
+        // A meshlet ends when it is full or the triangles start facing another way
+        if (meshlets.empty() || meshlets.back().triangleCount == MESHLET_MAX_TRIANGLES || keys[source] >> 30 != keys[order[t - 1]] >> 30)
+            meshlets.push_back(Meshlet{.firstTriangle = static_cast<uint32_t>(t)});
+        meshlets.back().triangleCount++;
+        sorted.insert(sorted.end(), vertexBufferObject.begin() + 6 * source, vertexBufferObject.begin() + 6 * source + 6);
+    }
+    vertexBufferObject.swap(sorted);
+
+    for (Meshlet& meshlet : meshlets) {
+        const glm::vec3* first = &vertexBufferObject[6 * meshlet.firstTriangle];
+        int vertexCount = static_cast<int>(meshlet.triangleCount) * 3;
+
+        // Sphere around the center of the bounding box
+        glm::vec3 low(std::numeric_limits<float>::max());
+        glm::vec3 high(-std::numeric_limits<float>::max());
+        glm::vec3 normalSum(0);
+        for (int v = 0; v < vertexCount; v++) {
+            low = glm::min(low, first[2 * v]);
+            high = glm::max(high, first[2 * v]);
+            normalSum += first[2 * v + 1];
+        }
+        meshlet.center = (low + high) * 0.5f;
+        for (int v = 0; v < vertexCount; v++) {
+            meshlet.radius = std::max(meshlet.radius, glm::length(first[2 * v] - meshlet.center));
+        }
+
+        // Interpolated normals are blends of the vertex normals and stay inside a cone
+        // around them as long as it is narrower than a hemisphere
+        if (glm::length(normalSum) < 1e-6f)
+            continue;
+        meshlet.coneAxis = glm::normalize(normalSum);
+        meshlet.coneCutoff = 1.0f;
+        for (int v = 0; v < vertexCount; v++) {
+            float length = glm::length(first[2 * v + 1]);
+            float cosine = length > 0.0f ? glm::dot(meshlet.coneAxis, first[2 * v + 1]) / length : -1.0f;
+            meshlet.coneCutoff = std::min(meshlet.coneCutoff, cosine);
+        }
+    }
+    return meshlets;
+}
+
+MeshletCuller::MeshletCuller(const Uniforms& uniforms, const glm::vec3& viewDirection, const HiZBuffer* hiZ)
+    : frustum(Frustum::fromMatrix(uniforms.projection * uniforms.view * uniforms.model)),
+      modelView(uniforms.view * uniforms.model),
+      hiZ(hiZ) {
+    // Normals are transformed by the model's 3x3 part, a rotation times a scale, so the
+    // view direction goes back through its transpose
+    glm::mat3 model(uniforms.model);
+    modelScale = glm::length(model[0]);
+    modelViewDirection = glm::normalize(glm::transpose(model) * viewDirection);
+    pixelsPerUnit = glm::vec2(uniforms.projection[0][0] * uniforms.viewport[0][0], uniforms.projection[1][1] * uniforms.viewport[1][1]);
+    screenCenter = glm::vec2(uniforms.viewport[3][0], uniforms.viewport[3][1]);
+}
+
+bool MeshletCuller::visible(const Meshlet& meshlet, MeshletStats& stats) const {
+    stats.tested++;
+    if (!frustum.intersectsSphere(meshlet.center, meshlet.radius)) {
+        stats.outsideFrustum++;
+        return false;
+    }
+
+    // Pixels are dropped where dot(view direction, normal) >= VIEW_CULL_EPSILON. The
+    // smallest that dot gets over the cone is the cosine of the angle to the axis plus
+    // the cone's half angle.
+    const float VIEW_CULL_EPSILON = 0.2f;
+    if (meshlet.coneCutoff > 0.0f) {
+        float cosAxis = glm::dot(modelViewDirection, meshlet.coneAxis);
+        float sinAxis = std::sqrt(std::max(0.0f, 1.0f - cosAxis * cosAxis));
+        float sinCone = std::sqrt(1.0f - meshlet.coneCutoff * meshlet.coneCutoff);
+        if (cosAxis * meshlet.coneCutoff - sinAxis * sinCone >= VIEW_CULL_EPSILON) {
+            stats.backfacing++;
+            return false;
+        }
+    }
+
+    if (hiZ) {
+        // Screen rectangle of the sphere's view space box, whose corners bound its projection
+        glm::vec4 center = modelView * glm::vec4(meshlet.center, 1.0f);
+        float radius = meshlet.radius * modelScale;
+        float depth = -center.z;
+        float nearest = depth - radius;
+        if (nearest > 0.0f) {
+            float farthest = depth + radius;
+            glm::vec2 low(center.x - radius, center.y - radius);
+            glm::vec2 high(center.x + radius, center.y + radius);
+            glm::vec2 screenMin = screenCenter + pixelsPerUnit * glm::vec2(std::min(low.x / nearest, low.x / farthest), std::min(low.y / nearest, low.y / farthest));
+            glm::vec2 screenMax = screenCenter + pixelsPerUnit * glm::vec2(std::max(high.x / nearest, high.x / farthest), std::max(high.y / nearest, high.y / farthest));
+            if (hiZ->occluded(screenMin, screenMax, nearest)) {
+                stats.occluded++;
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,237 @@
+#include "PostProcess.h"
+#include "JobSystem.h"
+
+#include <cmath>
+#include <algorithm>
+
+HdrBuffer* BufferPool::acquire(int width, int height) {
+    for (size_t i = 0; i < freeBuffers.size(); i++) {
+        HdrBuffer* buffer = freeBuffers[i];
+        if (buffer->width == width && buffer->height == height) {
+            freeBuffers[i] = freeBuffers.back();
+            freeBuffers.pop_back();
+            return buffer;
+        }
+    }
+    buffers.push_back(std::make_unique<HdrBuffer>(width, height));
+    freeBuffers.reserve(buffers.size());
+    allocationCount++;
+    return buffers.back().get();
+}
+
+void BufferPool::release(HdrBuffer* buffer) {
+    freeBuffers.push_back(buffer);
+}
+
+BloomPass::BloomPass(int downsample, int radius, float strength)
+    : downsample(downsample), strength(strength) {
+    float sigma = std::max(radius * 0.5f, 0.5f);
+    float sum = 0.0f;
+    for (int k = -radius; k <= radius; k++) {
+        weights.push_back(std::exp(-(k * k) / (2.0f * sigma * sigma)));
+        sum += weights.back();
+    }
+    for (float& weight : weights) {
+        weight /= sum;
+    }
+}
+
+// Box filters factor x factor pixels of the emissive buffer into one
+static void downsampleRows(const HdrBuffer& source, HdrBuffer& target, int factor, int yBegin, int yEnd) {
+    const std::vector<float>* sourcePlanes[3] = {&source.red, &source.green, &source.blue};
+    std::vector<float>* targetPlanes[3] = {&target.red, &target.green, &target.blue};
+
+    for (int plane = 0; plane < 3; plane++) {
+        for (int y = yBegin; y < yEnd; y++) {
+            float* out = targetPlanes[plane]->data() + y * target.width;
+            std::fill(out, out + target.width, 0.0f);
+
+            int sy0 = y * factor;
+            int sy1 = std::min(sy0 + factor, source.height);
+            for (int sy = sy0; sy < sy1; sy++) {
+                const float* in = sourcePlanes[plane]->data() + sy * source.width;
+                for (int x = 0; x < target.width; x++) {
+                    const float* block = in + x * factor;
+                    int columns = std::min(factor, source.width - x * factor);
+                    float sum = 0.0f;
+                    for (int k = 0; k < columns; k++) {
+                        sum += block[k];
+                    }
+                    out[x] += sum;
+                }
+            }
+
+            float invRows = 1.0f / (sy1 - sy0);
+            for (int x = 0; x < target.width; x++) {
+                int columns = std::min(factor, source.width - x * factor);
+                out[x] *= invRows / columns;
+            }
+        }
+    }
+}
+
+// Horizontal half of the separable blur, edges are clamped
+static void blurRowsHorizontal(const HdrBuffer& source, HdrBuffer& target, const std::vector<float>& weights, int yBegin, int yEnd) {
+    const std::vector<float>* sourcePlanes[3] = {&source.red, &source.green, &source.blue};
+    std::vector<float>* targetPlanes[3] = {&target.red, &target.green, &target.blue};
+    int radius = static_cast<int>(weights.size()) / 2;
+    int width = source.width;
+
+    for (int plane = 0; plane < 3; plane++) {
+        for (int y = yBegin; y < yEnd; y++) {
+            const float* in = sourcePlanes[plane]->data() + y * width;
+            float* out = targetPlanes[plane]->data() + y * width;
+            // Clamped taps near the edges, contiguous multiply-adds in between
+            auto clampedTap = [&](int x) {
+                float sum = 0.0f;
+                for (int k = -radius; k <= radius; k++) {
+                    sum += weights[k + radius] * in[std::clamp(x + k, 0, width - 1)];
+                }
+                return sum;
+            };
+            int interiorBegin = std::min(radius, width);
+            int interiorEnd = std::max(width - radius, interiorBegin);
+            for (int x = 0; x < interiorBegin; x++) {
+                out[x] = clampedTap(x);
+            }
+            for (int x = interiorEnd; x < width; x++) {
+                out[x] = clampedTap(x);
+            }
+            std::fill(out + interiorBegin, out + interiorEnd, 0.0f);
+            for (int k = -radius; k <= radius; k++) {
+                float weight = weights[k + radius];
+                for (int x = interiorBegin; x < interiorEnd; x++) {
+                    out[x] += weight * in[x + k];
+                }
+            }
+        }
+    }
+}
+
+// Vertical half, accumulates whole rows so the inner loop runs over contiguous floats
+static void blurRowsVertical(const HdrBuffer& source, HdrBuffer& target, const std::vector<float>& weights, int yBegin, int yEnd) {
+    const std::vector<float>* sourcePlanes[3] = {&source.red, &source.green, &source.blue};
+    std::vector<float>* targetPlanes[3] = {&target.red, &target.green, &target.blue};
+    int radius = static_cast<int>(weights.size()) / 2;
+    int width = source.width;
+
+    for (int plane = 0; plane < 3; plane++) {
+        for (int y = yBegin; y < yEnd; y++) {
+            float* out = targetPlanes[plane]->data() + y * width;
+            std::fill(out, out + width, 0.0f);
+            for (int k = -radius; k <= radius; k++) {
+                const float* in = sourcePlanes[plane]->data() + std::clamp(y + k, 0, source.height - 1) * width;
+                float weight = weights[k + radius];
+                for (int x = 0; x < width; x++) {
+                    out[x] += weight * in[x];
+                }
+            }
+        }
+    }
+}
+
+// Bilinearly upsamples the blurred bloom and adds it onto the scene color.
+// Pixels the bloom does not reach are left untouched.
+static void compositeRows(const PostTarget& target, const HdrBuffer& bloom, const BloomColumns& columns, const std::vector<char>& litRows, int factor, float strength, int yBegin, int yEnd) {
+    float scale = 1.0f / factor;
+    for (int y = yBegin; y < yEnd; y++) {
+        float by = std::clamp((y + 0.5f) * scale - 0.5f, 0.0f, static_cast<float>(bloom.height - 1));
+        int y0 = static_cast<int>(by);
+        int y1 = std::min(y0 + 1, bloom.height - 1);
+        float fy = by - y0;
+        if (!litRows[y0] && !litRows[y1])
+            continue;
+        const float* red[2] = {bloom.red.data() + y0 * bloom.width, bloom.red.data() + y1 * bloom.width};
+        const float* green[2] = {bloom.green.data() + y0 * bloom.width, bloom.green.data() + y1 * bloom.width};
+        const float* blue[2] = {bloom.blue.data() + y0 * bloom.width, bloom.blue.data() + y1 * bloom.width};
+
+        for (int x = 0; x < target.width; x++) {
+            int x0 = columns.left[x];
+            int x1 = columns.right[x];
+            float fx = columns.weight[x];
+            auto sample = [&](const float* const* rows) {
+                float top = rows[0][x0] + (rows[0][x1] - rows[0][x0]) * fx;
+                float bottom = rows[1][x0] + (rows[1][x1] - rows[1][x0]) * fx;
+                return (top + (bottom - top) * fy) * strength;
+            };
+            float r = sample(red);
+            float g = sample(green);
+            float b = sample(blue);
+            if (r + g + b <= 0.0f)
+                continue;
+
+            if (target.hdr) {
+                int index = y * target.width + x;
+                target.hdr->red[index] += r;
+                target.hdr->green[index] += g;
+                target.hdr->blue[index] += b;
+            } else {
+                // Same display curve as HdrBuffer::write(): squared in, sqrt out
+                Uint32& pixel = target.ldr[y * target.ldrStride + x];
+                auto add = [](Uint32 channel, float light) {
+                    float value = channel * (1.0f / 255.0f);
+                    return static_cast<Uint32>(std::sqrt(std::min(value * value + light, 1.0f)) * 255.0f + 0.5f);
+                };
+                pixel = (pixel & 0xFF000000u) | (add((pixel >> 16) & 0xFF, r) << 16) | (add((pixel >> 8) & 0xFF, g) << 8) | add(pixel & 0xFF, b);
+            }
+        }
+    }
+}
+
+void BloomPass::run(const PostTarget& target, BufferPool& buffers, JobSystem& jobs) {
+    int width = (target.width + downsample - 1) / downsample;
+    int height = (target.height + downsample - 1) / downsample;
+    HdrBuffer* ping = buffers.acquire(width, height);
+    HdrBuffer* pong = buffers.acquire(width, height);
+
+    jobs.parallelFor(height, [&](int begin, int end) {
+        downsampleRows(*target.emissive, *ping, downsample, begin, end);
+    });
+    jobs.parallelFor(height, [&](int begin, int end) {
+        blurRowsHorizontal(*ping, *pong, weights, begin, end);
+    });
+    jobs.parallelFor(height, [&](int begin, int end) {
+        blurRowsVertical(*pong, *ping, weights, begin, end);
+    });
+
+    // Bilinear taps per output column, only rebuilt when the size changes
+    if (static_cast<int>(columns.left.size()) != target.width || columns.bloomWidth != width) {
+        columns.bloomWidth = width;
+        columns.left.resize(target.width);
+        columns.right.resize(target.width);
+        columns.weight.resize(target.width);
+        for (int x = 0; x < target.width; x++) {
+            float bx = std::clamp((x + 0.5f) / downsample - 0.5f, 0.0f, static_cast<float>(width - 1));
+            columns.left[x] = static_cast<int>(bx);
+            columns.right[x] = std::min(columns.left[x] + 1, width - 1);
+            columns.weight[x] = bx - columns.left[x];
+        }
+    }
+
+    // Most of the screen gets no bloom at all, remember which bloom rows have any
+    litRows.resize(height);
+    jobs.parallelFor(height, [&](int begin, int end) {
+        for (int y = begin; y < end; y++) {
+            float sum = 0.0f;
+            for (int x = 0; x < width; x++) {
+                int index = y * width + x;
+                sum += ping->red[index] + ping->green[index] + ping->blue[index];
+            }
+            litRows[y] = sum > 0.0f;
+        }
+    });
+    jobs.parallelFor(target.height, [&](int begin, int end) {
+        compositeRows(target, *ping, columns, litRows, downsample, strength, begin, end);
+    });
+
+    buffers.release(pong);
+    buffers.release(ping);
+}
+
+void PostChain::run(const PostTarget& target, JobSystem& jobs, FrameStats& stats) {
+    for (const std::unique_ptr<PostPass>& pass : passes) {
+        Uint64 passStart = SDL_GetPerformanceCounter();
+        pass->run(target, buffers, jobs);
+        stats.addPassTime(pass->name(), SDL_GetPerformanceCounter() - passStart);
+    }
+}
@@ -10,7 +10,8 @@ void drawPoint(SDL_Renderer* renderer, float x_position, float y_position, const
     SDL_RenderDrawPoint(renderer, static_cast<int>(x_position), *globalScreenHeight - static_cast<int>(y_position));
 }
 
-std::vector<Fragment> drawLine(const glm::vec3& start, const glm::vec3& end, const Color& color) {
+// Appends the Bresenham line from start to end
+static void appendLine(const glm::vec3& start, const glm::vec3& end, const Color& color, std::pmr::vector<Fragment>& lineFragments) {
     int x0 = static_cast<int>(start.x);
     int y0 = static_cast<int>(start.y);
     int x1 = static_cast<int>(end.x);
@@ -22,8 +23,6 @@ std::vector<Fragment> drawLine(const glm::vec3& start, const glm::vec3& end, con
     int sy = (y0 < y1) ? 1 : -1;
     int err = dx - dy;
 
-    std::vector<Fragment> lineFragments;
-
     while (true) {
         lineFragments.push_back(Fragment(x0, y0, 0.0f, color));
 
@@ -38,48 +37,42 @@ std::vector<Fragment> drawLine(const glm::vec3& start, const glm::vec3& end, con
             y0 += sy;
         }
     }
-
-    return lineFragments;
 }
 
-std::vector<Fragment> drawTriangle(const glm::vec3& pointA, const glm::vec3& pointB, const glm::vec3& pointC, const Color& color) {
-    std::vector<Fragment> triangleFragments;
-    
-    std::vector<Fragment> lineAB = drawLine(pointA, pointB, color);
-    std::vector<Fragment> lineBC = drawLine(pointB, pointC, color);
-    std::vector<Fragment> lineCA = drawLine(pointC, pointA, color);
-
-    triangleFragments.insert(
-        triangleFragments.end(),
-        lineAB.begin(),
-        lineAB.end()
-    );
-
-    triangleFragments.insert(
-        triangleFragments.end(),
-        lineBC.begin(),
-        lineBC.end()
-    );
+// Fragments a line from start to end produces
+static size_t lineLength(const glm::vec3& start, const glm::vec3& end) {
+    int dx = abs(static_cast<int>(end.x) - static_cast<int>(start.x));
+    int dy = abs(static_cast<int>(end.y) - static_cast<int>(start.y));
+    return static_cast<size_t>(std::max(dx, dy)) + 1;
+}
 
-    triangleFragments.insert(
-        triangleFragments.end(),
-        lineCA.begin(),
-        lineCA.end()
-    );
+std::pmr::vector<Fragment> drawLine(const glm::vec3& start, const glm::vec3& end, const Color& color, std::pmr::memory_resource* memory) {
+    std::pmr::vector<Fragment> lineFragments(memory);
+    lineFragments.reserve(lineLength(start, end));
+    appendLine(start, end, color, lineFragments);
+    return lineFragments;
+}
 
+std::pmr::vector<Fragment> drawTriangle(const glm::vec3& pointA, const glm::vec3& pointB, const glm::vec3& pointC, const Color& color, std::pmr::memory_resource* memory) {
+    // The three edges go straight into one list
+    std::pmr::vector<Fragment> triangleFragments(memory);
+    triangleFragments.reserve(lineLength(pointA, pointB) + lineLength(pointB, pointC) + lineLength(pointC, pointA));
+    appendLine(pointA, pointB, color, triangleFragments);
+    appendLine(pointB, pointC, color, triangleFragments);
+    appendLine(pointC, pointA, color, triangleFragments);
     return triangleFragments;
 }
 
-std::vector<Fragment> drawTriangle(const std::vector<Vertex>& triangle, const Color& color) {
-    return drawTriangle(triangle[0].position, triangle[1].position, triangle[2].position, color);
+std::pmr::vector<Fragment> drawTriangle(const Triangle& triangle, const Color& color, std::pmr::memory_resource* memory) {
+    return drawTriangle(triangle[0].position, triangle[1].position, triangle[2].position, color, memory);
 }
 
-std::vector<Fragment> getTriangleFragments(Vertex a, Vertex b, Vertex c, const int SCREEN_WIDTH, const int SCREEN_HEIGHT, const Camera& camera) {
+std::pmr::vector<Fragment> getTriangleFragments(Vertex a, Vertex b, Vertex c, const int SCREEN_WIDTH, const int SCREEN_HEIGHT, const Camera& camera, std::pmr::memory_resource* memory) {
     glm::vec3 A = a.position;
     glm::vec3 B = b.position;
     glm::vec3 C = c.position;
 
-    std::vector<Fragment> triangleFragments;
+    std::pmr::vector<Fragment> triangleFragments(memory);
 
     // Build bounding box
     int minX = static_cast<int>( std::ceil( std::min(std::min(A.x, B.x), C.x) ) );
@@ -166,28 +159,23 @@ std::vector<glm::vec3> setupVertexBufferObject(const std::vector<glm::vec3>& ver
     return vertexBufferObject;
 }
 
-std::vector<std::vector<Vertex>> primitiveAssembly (const std::vector<Vertex>& transformedVertices) {
-    // Group your vertices in groups of 3
-    std::vector<std::vector<Vertex>> assembledVertices;
-
-    for (int i = 0; i < transformedVertices.size() - 1; i += 3) {
-        std::vector<Vertex> vertexGroup;
-        vertexGroup.push_back(transformedVertices[i]);
-        vertexGroup.push_back(transformedVertices[i + 1]);
-        vertexGroup.push_back(transformedVertices[i + 2]);
+std::pmr::vector<Triangle> primitiveAssembly(std::span<const Vertex> transformedVertices, std::pmr::memory_resource* memory) {
+    // Group the vertices in groups of 3
+    std::pmr::vector<Triangle> triangles(memory);
+    triangles.reserve(transformedVertices.size() / 3);
 
-        assembledVertices.push_back(vertexGroup);
+    for (size_t i = 0; i + 2 < transformedVertices.size(); i += 3) {
+        triangles.push_back(Triangle{{transformedVertices[i], transformedVertices[i + 1], transformedVertices[i + 2]}});
     }
-    
-    // Return your assembled vertices
-    return assembledVertices;
+
+    return triangles;
 }
 
-std::vector<Fragment> rasterize(const std::vector<std::vector<glm::vec3>>& assembledVertices) {
-    std::vector<Fragment> fragments;
+std::pmr::vector<Fragment> rasterize(std::span<const Triangle> triangles, std::pmr::memory_resource* memory) {
+    std::pmr::vector<Fragment> fragments(memory);
 
-    for (const std::vector<glm::vec3>& triangleVertices : assembledVertices) {
-        std::vector<Fragment> triangleFragments = drawTriangle(triangleVertices[0], triangleVertices[1], triangleVertices[2]);
+    for (const Triangle& triangle : triangles) {
+        std::pmr::vector<Fragment> triangleFragments = drawTriangle(triangle, Color(255, 255, 255), memory);
         fragments.insert(fragments.end(), triangleFragments.begin(), triangleFragments.end());
     }
 
@@ -311,3 +299,27 @@ glm::vec3 calculateTriangleNormal(glm::vec3 A,glm::vec3 B, glm::vec3 C) {
 
     return normal;
 }
+
+bool triangleScreenBounds(const Vertex& a, const Vertex& b, const Vertex& c, const int SCREEN_WIDTH, const int SCREEN_HEIGHT, int& minX, int& minY, int& maxX, int& maxY) {
+    glm::vec3 A = a.position;
+    glm::vec3 B = b.position;
+    glm::vec3 C = c.position;
+
+    // Build bounding box
+    minX = static_cast<int>( std::ceil( std::min(std::min(A.x, B.x), C.x) ) );
+    minY = static_cast<int>( std::ceil( std::min(std::min(A.y, B.y), C.y) ) );
+    maxX = static_cast<int>( std::floor( std::max(std::max(A.x, B.x), C.x) ) );
+    maxY = static_cast<int>( std::floor( std::max(std::max(A.y, B.y), C.y) ) );
+
+    // Check if bounding box is outside screen
+    if (!bBoxInsideScreen(minX, minY, maxX, maxY, SCREEN_WIDTH, SCREEN_WIDTH))
+    return false;
+
+    // Clip the bounding box to the screen
+    minX = std::max(minX, 0);
+    minY = std::max(minY, 0);
+    maxX = std::min(maxX, SCREEN_WIDTH - 1);
+    maxY = std::min(maxY, SCREEN_HEIGHT - 1);
+
+    return minX <= maxX && minY <= maxY;
+}
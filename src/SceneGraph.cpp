@@ -0,0 +1,68 @@
+#include "SceneGraph.h"
+
+#include <cmath>
+
+// translation * scale * rotation about Y, built directly instead of multiplying three matrices
+static glm::mat4 localMatrix(const glm::vec3& translation, const glm::vec3& scale, float rotation) {
+    float c = std::cos(rotation);
+    float s = std::sin(rotation);
+    glm::mat4 matrix(1.0f);
+    matrix[0] = glm::vec4(scale.x * c, 0.0f, -scale.z * s, 0.0f);
+    matrix[1] = glm::vec4(0.0f, scale.y, 0.0f, 0.0f);
+    matrix[2] = glm::vec4(scale.x * s, 0.0f, scale.z * c, 0.0f);
+    matrix[3] = glm::vec4(translation, 1.0f);
+    return matrix;
+}
+
+SceneNode SceneGraph::addNode(SceneNode parent, const glm::vec3& translation, const glm::vec3& scale, float rotation) {
+    SceneNode node = size();
+    translations.push_back(translation);
+    scales.push_back(scale);
+    rotations.push_back(rotation);
+    parents.push_back(parent < node ? parent : NO_PARENT);
+    dirty.push_back(1);
+    changed.push_back(0);
+    worldMatrices.push_back(glm::mat4(1.0f));
+    return node;
+}
+
+void SceneGraph::setTranslation(SceneNode node, const glm::vec3& translation) {
+    if (translations[node] != translation) {
+        translations[node] = translation;
+        dirty[node] = 1;
+    }
+}
+
+void SceneGraph::setScale(SceneNode node, const glm::vec3& scale) {
+    if (scales[node] != scale) {
+        scales[node] = scale;
+        dirty[node] = 1;
+    }
+}
+
+void SceneGraph::setRotation(SceneNode node, float rotation) {
+    if (rotations[node] != rotation) {
+        rotations[node] = rotation;
+        dirty[node] = 1;
+    }
+}
+
+int SceneGraph::updateWorldTransforms() {
+    int updated = 0;
+    int count = size();
+    for (SceneNode node = 0; node < count; node++) {
+        SceneNode parent = parents[node];
+        // Parents come first, so their changed flag is already final
+        bool update = dirty[node] || (parent != NO_PARENT && changed[parent]);
+        changed[node] = update;
+        if (!update)
+            continue;
+        dirty[node] = 0;
+        updated++;
+
+        glm::mat4 local = localMatrix(translations[node], scales[node], rotations[node]);
+        glm::mat4& world = worldMatrices[node];
+        world = parent != NO_PARENT ? worldMatrices[parent] * local : local;
+    }
+    return updated;
+}
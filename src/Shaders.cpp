@@ -2,17 +2,21 @@
 #include "Shaders.h"
 
 Vertex vertexShader(const Vertex& vertex, const Uniforms& uniforms) {
-    // Apply transformations to the input vertex using the matrices from the uniforms
-    glm::vec4 clipSpaceVertex = uniforms.projection * uniforms.view * uniforms.model * glm::vec4(vertex.position, 1.0f);
+    return vertexShader(vertex, VertexTransform(uniforms));
+}
+
+Vertex vertexShader(const Vertex& vertex, const VertexTransform& transform) {
+    // Apply transformations to the input vertex using the combined matrices
+    glm::vec4 clipSpaceVertex = transform.modelViewProjection * glm::vec4(vertex.position, 1.0f);
 
     // Perspective divide
     glm::vec3 ndcVertex = glm::vec3(clipSpaceVertex) / clipSpaceVertex.w;
 
     // Apply the viewport transform
-    glm::vec4 screenVertex = uniforms.viewport * glm::vec4(ndcVertex, 1.0f);
+    glm::vec4 screenVertex = transform.viewport * glm::vec4(ndcVertex, 1.0f);
 
     // Transform the normal
-    glm::vec3 transformedNormal = glm::mat3(uniforms.model) * vertex.normal;
+    glm::vec3 transformedNormal = transform.normalMatrix * vertex.normal;
     transformedNormal = glm::normalize(transformedNormal);
 
     // Return the transformed vertex
@@ -23,125 +27,153 @@ Vertex vertexShader(const Vertex& vertex, const Uniforms& uniforms) {
     };
 }
 
-Fragment stripedPlanetFragmentShader(const Fragment& fragment) {
-    glm::vec3 fragmentPosition(fragment.x, fragment.y, fragment.z);
-    Color fragmentColor = Color(120, 0, 220);
+// Samples noise at originalPosition * scale for every lane of the block
+template <unsigned Interpolants>
+static void sampleBlockNoise(const FastNoiseLite& noise, const FragmentBlock<Interpolants>& block, float scale, float* out) {
+    alignas(32) float xs[BLOCK_PIXELS];
+    alignas(32) float ys[BLOCK_PIXELS];
+    alignas(32) float zs[BLOCK_PIXELS];
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        xs[i] = block.originalX[i] * scale;
+        ys[i] = block.originalY[i] * scale;
+        zs[i] = block.originalZ[i] * scale;
+    }
+    noise.GetNoiseBatch(xs, ys, zs, out, BLOCK_PIXELS);
+}
 
-    float intensity = fragment.intensity;
+void StripedPlanetFragmentShader::operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const {
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        ColorF fragmentColor = ColorF(120, 0, 220);
 
-    float xPos = fragment.originalPosition.x;
-    float yPos = fragment.originalPosition.y;
+        float intensity = block.intensity[i];
 
-    fragmentColor = fragmentColor + Color(0, 0, 255) * 1.2f * std::abs(std::sin(6 * (3.1416f * yPos) + 0.5f) * std::sin(9 * 3.1416f * yPos + 20 * std::pow(yPos, 3)) + 0.6f * std::sin(0.4f * 3.146f * xPos + 3));
+        float xPos = block.originalX[i];
+        float yPos = block.originalY[i];
 
-    Fragment shadedFragment = Fragment(fragmentPosition, fragmentColor * intensity);
-    
-    return shadedFragment;
+        fragmentColor = fragmentColor + ColorF(0, 0, 255) * 1.2f * std::abs(std::sin(6 * (3.1416f * yPos) + 0.5f) * std::sin(9 * 3.1416f * yPos + 20 * std::pow(yPos, 3)) + 0.6f * std::sin(0.4f * 3.146f * xPos + 3));
+
+        colors[i] = fragmentColor * intensity;
+    }
 }
 
-Fragment earthPlanetFragmentShader(const Fragment& fragment) {
-    glm::vec3 fragmentPosition(fragment.x, fragment.y, fragment.z);
-    float intensity = fragment.intensity;
+void EarthPlanetFragmentShader::operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const {
     FastNoiseLite noise;
     noise.SetSeed(123);  // Set a seed for reproducibility
     noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
 
     // Scale determines the level of detail in the noise
     float scale = 700.0f;
+    alignas(32) float elevation[BLOCK_PIXELS];
+    sampleBlockNoise(noise, block, scale, elevation);
 
-    // Use Perlin noise to generate elevation
-    float elevation = 10.0f * noise.GetNoise(fragment.originalPosition.x * scale, fragment.originalPosition.y * scale, fragment.originalPosition.z * scale);
-    elevation += 1.0f;
-    elevation *= 0.5f;
-
-    // Threshold for land and water
-    float landThreshold = 0.88f;
-    float waterThreshold = 0.6f;
-
-    // Determine if the fragment is land or water
-    Color fragmentColor;
-    if (elevation > landThreshold) {
-        // Land color (green)
-        fragmentColor = Color(0, 160, 0);
-    } else if (elevation > waterThreshold) {
-        // Shallow water color (light blue)
-        fragmentColor = Color(173, 216, 230);
-    } else {
-        // Deep water color (dark blue)
-        fragmentColor = Color(0, 0, 128);
-    }
-
+    // Clouds drift with the screen position of the fragment
     float cloudScale = 550.0f;
-    float cloudCoverage = noise.GetNoise(fragment.originalPosition.x * cloudScale + fragment.x, fragment.originalPosition.y * cloudScale + fragment.y, fragment.originalPosition.z * cloudScale + fragment.z);
-    cloudCoverage += 1.0f;
-    cloudCoverage *= 0.5f;
-
-    float cloudThreshold = 0.7f;
-    if (cloudCoverage > cloudThreshold) {
-        fragmentColor = fragmentColor +  Color(220, 220, 220) * cloudCoverage;
+    alignas(32) float cloudX[BLOCK_PIXELS];
+    alignas(32) float cloudY[BLOCK_PIXELS];
+    alignas(32) float cloudZ[BLOCK_PIXELS];
+    alignas(32) float cloudCoverage[BLOCK_PIXELS];
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        cloudX[i] = block.originalX[i] * cloudScale + block.pixelX(i);
+        cloudY[i] = block.originalY[i] * cloudScale + block.pixelY(i);
+        cloudZ[i] = block.originalZ[i] * cloudScale + block.z[i];
+    }
+    noise.GetNoiseBatch(cloudX, cloudY, cloudZ, cloudCoverage, BLOCK_PIXELS);
+
+    alignas(32) float noiseValue[BLOCK_PIXELS];
+    sampleBlockNoise(noise, block, 400.0f, noiseValue);
+
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        float intensity = block.intensity[i];
+
+        // Use Perlin noise to generate elevation
+        float height = 10.0f * elevation[i];
+        height += 1.0f;
+        height *= 0.5f;
+
+        // Threshold for land and water
+        float landThreshold = 0.88f;
+        float waterThreshold = 0.6f;
+
+        // Determine if the fragment is land or water
+        ColorF fragmentColor;
+        if (height > landThreshold) {
+            // Land color (green)
+            fragmentColor = ColorF(0, 160, 0);
+        } else if (height > waterThreshold) {
+            // Shallow water color (light blue)
+            fragmentColor = ColorF(173, 216, 230);
+        } else {
+            // Deep water color (dark blue)
+            fragmentColor = ColorF(0, 0, 128);
+        }
+
+        float coverage = cloudCoverage[i];
+        coverage += 1.0f;
+        coverage *= 0.5f;
+
+        float cloudThreshold = 0.7f;
+        if (coverage > cloudThreshold) {
+            fragmentColor = fragmentColor +  ColorF(220, 220, 220) * coverage;
+        }
+
+        // Apply variations based on noise for a more natural look
+        fragmentColor = fragmentColor * (1.0f + 0.5f * noiseValue[i]);
+
+        // Apply intensity based on elevation for some 3D effect
+        intensity *= 1.0f - height * 0.1f;
+        fragmentColor = fragmentColor * intensity;
+
+        colors[i] = fragmentColor;
     }
-
-    // Apply variations based on noise for a more natural look
-    float noiseValue = noise.GetNoise(fragment.originalPosition.x * 400.0f, fragment.originalPosition.y * 400.0f, fragment.originalPosition.z * 400.0f);
-    fragmentColor = fragmentColor * (1.0f + 0.5f * noiseValue);
-
-    // Apply intensity based on elevation for some 3D effect
-    intensity *= 1.0f - elevation * 0.1f;
-    fragmentColor = fragmentColor * intensity;
-
-    Fragment shadedFragment = Fragment(fragmentPosition, fragmentColor);
-    
-    return shadedFragment;
 }
 
-Fragment moonFragmentShader(const Fragment& fragment) {
-    glm::vec3 fragmentPosition(fragment.x, fragment.y, fragment.z);
-    float intensity = fragment.intensity;
+void MoonFragmentShader::operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const {
     FastNoiseLite noise;
     noise.SetSeed(456);  // Set a different seed for variety
     noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
 
     // Scale determines the level of detail in the noise
     float scale = 900.0f;
+    alignas(32) float craterNoise[BLOCK_PIXELS];
+    sampleBlockNoise(noise, block, scale, craterNoise);
 
-    // Use Perlin noise to generate crater formations
-    float craterFormation = noise.GetNoise(fragment.originalPosition.x * scale, fragment.originalPosition.y * scale, fragment.originalPosition.z * scale);
-    craterFormation = (craterFormation + 1.0f) * 0.5f;
-
-    // Threshold for craters
-    float craterThreshold = 0.8f;
-
-    // Determine if the fragment is part of a crater or not
-    Color fragmentColor;
-    if (craterFormation > craterThreshold) {
-        // Crater color (dark gray)
-        fragmentColor = Color(50, 50, 50);
-    } else {
-        // Moon surface color (light gray)
-        fragmentColor = Color(180, 180, 180);
-    }
+    alignas(32) float noiseValue[BLOCK_PIXELS];
+    sampleBlockNoise(noise, block, 300.0f, noiseValue);
 
-    // Apply variations based on noise for a more natural look
-    float noiseValue = noise.GetNoise(fragment.originalPosition.x * 300.0f, fragment.originalPosition.y * 300.0f, fragment.originalPosition.z * 300.0f);
-    fragmentColor = fragmentColor * (1.0f + 0.2f * noiseValue);
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        float intensity = block.intensity[i];
 
-    // Apply intensity to the crater color
-    intensity *= 1.0f - craterFormation * 0.1f;
-    fragmentColor = fragmentColor * intensity;
+        // Use Perlin noise to generate crater formations
+        float craterFormation = (craterNoise[i] + 1.0f) * 0.5f;
 
-    Fragment shadedFragment = Fragment(fragmentPosition, fragmentColor);
+        // Threshold for craters
+        float craterThreshold = 0.8f;
 
-    return shadedFragment;
-}
+        // Determine if the fragment is part of a crater or not
+        ColorF fragmentColor;
+        if (craterFormation > craterThreshold) {
+            // Crater color (dark gray)
+            fragmentColor = ColorF(50, 50, 50);
+        } else {
+            // Moon surface color (light gray)
+            fragmentColor = ColorF(180, 180, 180);
+        }
+
+        // Apply variations based on noise for a more natural look
+        fragmentColor = fragmentColor * (1.0f + 0.2f * noiseValue[i]);
 
+        // Apply intensity to the crater color
+        intensity *= 1.0f - craterFormation * 0.1f;
+        fragmentColor = fragmentColor * intensity;
 
-Fragment starFragmentShader(const Fragment& fragment) {
-    glm::vec3 fragmentPosition(fragment.x, fragment.y, fragment.z);
-    Color baseColor = Color(255, 40, 0) * 0.5f;
-    Color highlightColor = Color(255, 103, 0);
+        colors[i] = fragmentColor;
+    }
+}
 
-    // Calculate distance from the center of the screen
-    float distanceToCenter = glm::length(glm::vec2(fragment.x, fragment.y));
+
+void StarFragmentShader::operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const {
+    ColorF baseColor = ColorF(255, 40, 0) * 0.5f;
+    ColorF highlightColor = ColorF(255, 103, 0);
 
     // Create a FastNoiseLite instance for generating noise
     FastNoiseLite noise;
@@ -149,63 +181,42 @@ Fragment starFragmentShader(const Fragment& fragment) {
 
     // Scale the coordinates to control the noise pattern
     float scale = 1600.0f;
-    float noiseValue = noise.GetNoise(fragment.originalPosition.x * scale, fragment.originalPosition.y * scale, fragment.originalPosition.z * scale);
-    noiseValue = 1.0f + 0.5f * noiseValue;
+    alignas(32) float noiseSample[BLOCK_PIXELS];
+    sampleBlockNoise(noise, block, scale, noiseSample);
 
-    // Add variations to the intensity based on the noise value
-    float intensity = (noiseValue < 0.7f) ? 0.0f : noiseValue;
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        float noiseValue = 1.0f + 0.5f * noiseSample[i];
 
-    // Vary the color based on noiseValue
-    Color fragmentColor = baseColor * (1.0f/(intensity + 0.0001f)) + highlightColor * intensity;
-    fragmentColor = (noiseValue < 0.7f) ? baseColor : fragmentColor;
+        // Add variations to the intensity based on the noise value
+        float intensity = (noiseValue < 0.7f) ? 0.0f : noiseValue;
 
-    Fragment shadedFragment = Fragment(fragmentPosition, fragmentColor);
+        // Vary the color based on noiseValue
+        ColorF fragmentColor = baseColor * (1.0f/(intensity + 0.0001f)) + highlightColor * intensity;
+        fragmentColor = (noiseValue < 0.7f) ? baseColor : fragmentColor;
 
-    return shadedFragment;
+        colors[i] = fragmentColor;
+    }
 }
 
-Fragment redPlanetFragmentShader(const Fragment& fragment) {
-    glm::vec3 fragmentPosition(fragment.x, fragment.y, fragment.z);
+void RedPlanetFragmentShader::operator()(const FragmentBlock<interpolants>& block, ColorF* colors) const {
     FastNoiseLite noise;
     noise.SetSeed(123);
-    Color baseColor = Color(255, 0, 0);
-    Color highLightColor = Color(0, 255, 255);
-
-    float intensity = fragment.intensity;
+    ColorF baseColor = ColorF(255, 0, 0);
+    ColorF highLightColor = ColorF(0, 255, 255);
 
-    float xPos = fragment.originalPosition.x;
-    float yPos = fragment.originalPosition.y;
-    
     float scale = 400.0f;
-    float noiseValue = noise.GetNoise(fragment.originalPosition.x * scale, fragment.originalPosition.y * scale, fragment.originalPosition.z * scale);
-    noiseValue += 1.0f;
-    noiseValue *= 0.5f;
-    
-    Color fragmentColor = baseColor * noiseValue + highLightColor * (1 - noiseValue + 0.1f);
-
-    Fragment shadedFragment = Fragment(fragmentPosition, fragmentColor * intensity);
-    
-    return shadedFragment;
-}
-
-Fragment testFragmentShader(const Fragment& fragment) {
-    glm::vec3 fragmentPosition(fragment.x, fragment.y, fragment.z);
-    Color fragmentColor = Color(220, 220, 220);
-
-    float intensity = fragment.intensity;
-  
-    Fragment shadedFragment = Fragment(fragmentPosition, fragmentColor * intensity);
+    alignas(32) float noiseSample[BLOCK_PIXELS];
+    sampleBlockNoise(noise, block, scale, noiseSample);
 
-    return shadedFragment;
-}
+    for (int i = 0; i < BLOCK_PIXELS; i++) {
+        float intensity = block.intensity[i];
 
-Fragment shipFragmentShader(const Fragment& fragment) {
-    glm::vec3 fragmentPosition(fragment.x, fragment.y, fragment.z);
-    Color fragmentColor = Color(255, 20, 20);
+        float noiseValue = noiseSample[i];
+        noiseValue += 1.0f;
+        noiseValue *= 0.5f;
 
-    float intensity = fragment.intensity;
+        ColorF fragmentColor = baseColor * noiseValue + highLightColor * (1 - noiseValue + 0.1f);
 
-    Fragment shadedFragment = Fragment(fragmentPosition, fragmentColor * intensity);
-    
-    return shadedFragment;
-}
\ No newline at end of file
+        colors[i] = fragmentColor * intensity;
+    }
+}
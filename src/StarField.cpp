@@ -0,0 +1,221 @@
+#include "StarField.h"
+#include "FastRandom.h"
+#include "JobSystem.h"
+#include "LinearAllocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define STAR_USE_SSE2
+#endif
+
+void StarField::generate(int count, float innerRadius, float outerRadius, uint64_t seed, JobSystem& jobs) {
+    xs.resize(count);
+    ys.resize(count);
+    zs.resize(count);
+    radii.resize(count);
+    brightnesses.resize(count);
+
+    float innerCubed = innerRadius * innerRadius * innerRadius;
+    float outerCubed = outerRadius * outerRadius * outerRadius;
+    int chunkCount = (count + STAR_CHUNK - 1) / STAR_CHUNK;
+    jobs.parallelFor(chunkCount, [&](int begin, int end) {
+        for (int chunk = begin; chunk < end; chunk++) {
+            // A generator per chunk, so the field doesn't depend on how the chunks were
+            // spread over the workers
+            FastRandom random(seed + static_cast<uint64_t>(chunk));
+            int last = std::min(count, (chunk + 1) * STAR_CHUNK);
+            for (int i = chunk * STAR_CHUNK; i < last; i++) {
+                // Even over the sphere: uniform height and angle around it. Even through
+                // the shell's volume: uniform in the cube of the distance.
+                float height = random.uniform(-1.0f, 1.0f);
+                float angle = 6.2831853f * random.uniform();
+                float ring = std::sqrt(1.0f - height * height);
+                float distance = std::cbrt(innerCubed + (outerCubed - innerCubed) * random.uniform());
+                xs[i] = distance * ring * std::cos(angle);
+                ys[i] = distance * height;
+                zs[i] = distance * ring * std::sin(angle);
+
+                // Steep powers leave most stars faint and small, with a few bright big ones
+                float magnitude = random.uniform();
+                float magnitude2 = magnitude * magnitude;
+                float magnitude4 = magnitude2 * magnitude2;
+                brightnesses[i] = 40.0f + 215.0f * magnitude4;
+                radii[i] = 0.5f + (STAR_MAX_RADIUS - 0.5f) * magnitude4 * magnitude4;
+            }
+        }
+    }, 1);
+}
+
+// The parts of the view-projection and viewport project() needs
+struct StarProjection {
+    glm::mat4 clip;
+    glm::vec3 scale;        // Viewport diagonal
+    glm::vec3 offset;       // Viewport translation
+    glm::vec2 min;          // Screen rectangle a star's center may be in, grown by the
+    glm::vec2 max;          // largest radius
+};
+
+// Projects stars [first, last) into out, returns how many are on screen
+static int projectStars(const float* xs, const float* ys, const float* zs, const float* radii, const float* brightnesses,
+    int first, int last, const StarProjection& p, ProjectedStar* out) {
+    int visible = 0;
+    int i = first;
+#if defined(__AVX2__)
+    const __m256 c00 = _mm256_set1_ps(p.clip[0][0]), c01 = _mm256_set1_ps(p.clip[0][1]), c02 = _mm256_set1_ps(p.clip[0][2]), c03 = _mm256_set1_ps(p.clip[0][3]);
+    const __m256 c10 = _mm256_set1_ps(p.clip[1][0]), c11 = _mm256_set1_ps(p.clip[1][1]), c12 = _mm256_set1_ps(p.clip[1][2]), c13 = _mm256_set1_ps(p.clip[1][3]);
+    const __m256 c20 = _mm256_set1_ps(p.clip[2][0]), c21 = _mm256_set1_ps(p.clip[2][1]), c22 = _mm256_set1_ps(p.clip[2][2]), c23 = _mm256_set1_ps(p.clip[2][3]);
+    const __m256 c30 = _mm256_set1_ps(p.clip[3][0]), c31 = _mm256_set1_ps(p.clip[3][1]), c32 = _mm256_set1_ps(p.clip[3][2]), c33 = _mm256_set1_ps(p.clip[3][3]);
+    const __m256 scaleX = _mm256_set1_ps(p.scale.x), scaleY = _mm256_set1_ps(p.scale.y), scaleZ = _mm256_set1_ps(p.scale.z);
+    const __m256 offsetX = _mm256_set1_ps(p.offset.x), offsetY = _mm256_set1_ps(p.offset.y), offsetZ = _mm256_set1_ps(p.offset.z);
+    const __m256 minX = _mm256_set1_ps(p.min.x), minY = _mm256_set1_ps(p.min.y);
+    const __m256 maxX = _mm256_set1_ps(p.max.x), maxY = _mm256_set1_ps(p.max.y);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    alignas(32) float screenX[8];
+    alignas(32) float screenY[8];
+    alignas(32) float screenZ[8];
+    for (; i + 8 <= last; i += 8) {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 clipX = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c00, x), _mm256_mul_ps(c10, y)), _mm256_add_ps(_mm256_mul_ps(c20, z), c30));
+        __m256 clipY = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c01, x), _mm256_mul_ps(c11, y)), _mm256_add_ps(_mm256_mul_ps(c21, z), c31));
+        __m256 clipZ = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c02, x), _mm256_mul_ps(c12, y)), _mm256_add_ps(_mm256_mul_ps(c22, z), c32));
+        __m256 clipW = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c03, x), _mm256_mul_ps(c13, y)), _mm256_add_ps(_mm256_mul_ps(c23, z), c33));
+
+        // In front of the near plane, then on screen after the divide
+        __m256 inFront = _mm256_cmp_ps(clipZ, _mm256_xor_ps(clipW, signMask), _CMP_GT_OQ);
+        __m256 inverseW = _mm256_div_ps(one, clipW);
+        __m256 sx = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(clipX, inverseW), scaleX), offsetX);
+        __m256 sy = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(clipY, inverseW), scaleY), offsetY);
+        __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(sx, minX, _CMP_GE_OQ), _mm256_cmp_ps(sx, maxX, _CMP_LT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(sy, minY, _CMP_GE_OQ), _mm256_cmp_ps(sy, maxY, _CMP_LT_OQ)));
+        unsigned lanes = static_cast<unsigned>(_mm256_movemask_ps(_mm256_and_ps(inFront, inside)));
+        if (lanes == 0)
+            continue;
+
+        __m256 sz = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(clipZ, inverseW), scaleZ), offsetZ);
+        _mm256_store_ps(screenX, sx);
+        _mm256_store_ps(screenY, sy);
+        _mm256_store_ps(screenZ, sz);
+        for (; lanes != 0; lanes &= lanes - 1) {
+            int lane = std::countr_zero(lanes);
+            out[visible++] = ProjectedStar{screenX[lane], screenY[lane], screenZ[lane], radii[i + lane], brightnesses[i + lane]};
+        }
+    }
+#elif defined(STAR_USE_SSE2)
+    const __m128 c00 = _mm_set1_ps(p.clip[0][0]), c01 = _mm_set1_ps(p.clip[0][1]), c02 = _mm_set1_ps(p.clip[0][2]), c03 = _mm_set1_ps(p.clip[0][3]);
+    const __m128 c10 = _mm_set1_ps(p.clip[1][0]), c11 = _mm_set1_ps(p.clip[1][1]), c12 = _mm_set1_ps(p.clip[1][2]), c13 = _mm_set1_ps(p.clip[1][3]);
+    const __m128 c20 = _mm_set1_ps(p.clip[2][0]), c21 = _mm_set1_ps(p.clip[2][1]), c22 = _mm_set1_ps(p.clip[2][2]), c23 = _mm_set1_ps(p.clip[2][3]);
+    const __m128 c30 = _mm_set1_ps(p.clip[3][0]), c31 = _mm_set1_ps(p.clip[3][1]), c32 = _mm_set1_ps(p.clip[3][2]), c33 = _mm_set1_ps(p.clip[3][3]);
+    const __m128 scaleX = _mm_set1_ps(p.scale.x), scaleY = _mm_set1_ps(p.scale.y), scaleZ = _mm_set1_ps(p.scale.z);
+    const __m128 offsetX = _mm_set1_ps(p.offset.x), offsetY = _mm_set1_ps(p.offset.y), offsetZ = _mm_set1_ps(p.offset.z);
+    const __m128 minX = _mm_set1_ps(p.min.x), minY = _mm_set1_ps(p.min.y);
+    const __m128 maxX = _mm_set1_ps(p.max.x), maxY = _mm_set1_ps(p.max.y);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    alignas(16) float screenX[4];
+    alignas(16) float screenY[4];
+    alignas(16) float screenZ[4];
+    for (; i + 4 <= last; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+        __m128 clipX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c00, x), _mm_mul_ps(c10, y)), _mm_add_ps(_mm_mul_ps(c20, z), c30));
+        __m128 clipY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c01, x), _mm_mul_ps(c11, y)), _mm_add_ps(_mm_mul_ps(c21, z), c31));
+        __m128 clipZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c02, x), _mm_mul_ps(c12, y)), _mm_add_ps(_mm_mul_ps(c22, z), c32));
+        __m128 clipW = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c03, x), _mm_mul_ps(c13, y)), _mm_add_ps(_mm_mul_ps(c23, z), c33));
+
+        __m128 inFront = _mm_cmpgt_ps(clipZ, _mm_xor_ps(clipW, signMask));
+        __m128 inverseW = _mm_div_ps(one, clipW);
+        __m128 sx = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(clipX, inverseW), scaleX), offsetX);
+        __m128 sy = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(clipY, inverseW), scaleY), offsetY);
+        __m128 inside = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(sx, minX), _mm_cmplt_ps(sx, maxX)),
+            _mm_and_ps(_mm_cmpge_ps(sy, minY), _mm_cmplt_ps(sy, maxY)));
+        unsigned lanes = static_cast<unsigned>(_mm_movemask_ps(_mm_and_ps(inFront, inside)));
+        if (lanes == 0)
+            continue;
+
+        __m128 sz = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(clipZ, inverseW), scaleZ), offsetZ);
+        _mm_store_ps(screenX, sx);
+        _mm_store_ps(screenY, sy);
+        _mm_store_ps(screenZ, sz);
+        for (; lanes != 0; lanes &= lanes - 1) {
+            int lane = std::countr_zero(lanes);
+            out[visible++] = ProjectedStar{screenX[lane], screenY[lane], screenZ[lane], radii[i + lane], brightnesses[i + lane]};
+        }
+    }
+#endif
+    for (; i < last; i++) {
+        glm::vec4 clip = p.clip * glm::vec4(xs[i], ys[i], zs[i], 1.0f);
+        if (!(clip.z > -clip.w))
+            continue;
+        glm::vec3 screen = p.scale * (glm::vec3(clip) / clip.w) + p.offset;
+        if (screen.x >= p.min.x && screen.x < p.max.x && screen.y >= p.min.y && screen.y < p.max.y)
+            out[visible++] = ProjectedStar{screen.x, screen.y, screen.z, radii[i], brightnesses[i]};
+    }
+    return visible;
+}
+
+ProjectedStars StarField::project(const glm::mat4& viewProjection, const glm::mat4& viewport, int width, int height, int bandHeight,
+    FrameArena& arena, JobSystem& jobs) const {
+    StarProjection projection;
+    projection.clip = viewProjection;
+    projection.scale = glm::vec3(viewport[0][0], viewport[1][1], viewport[2][2]);
+    projection.offset = glm::vec3(viewport[3]);
+    projection.min = glm::vec2(-STAR_MAX_RADIUS, -STAR_MAX_RADIUS);
+    projection.max = glm::vec2(width + STAR_MAX_RADIUS, height + STAR_MAX_RADIUS);
+
+    ProjectedStars result;
+    result.bandHeight = bandHeight;
+    result.bandCount = (height + bandHeight - 1) / bandHeight;
+    int chunkCount = (size() + STAR_CHUNK - 1) / STAR_CHUNK;
+    int startsPerChunk = result.bandCount + 1;
+    LinearAllocator& allocator = arena.local();
+    result.stars = allocator.allocateArray<const ProjectedStar*>(chunkCount);
+    result.bandStarts = allocator.allocateArray<uint32_t>(static_cast<size_t>(chunkCount) * startsPerChunk);
+
+    std::atomic<int> visible{0};
+    jobs.parallelFor(chunkCount, [&](int begin, int end) {
+        // Projected into the stack, then counting sorted by band into exactly as much
+        // arena memory as is on screen
+        ProjectedStar projected[STAR_CHUNK];
+        uint16_t bands[STAR_CHUNK];
+        LinearAllocator& local = arena.local();
+        std::span<uint32_t> next = local.allocateArray<uint32_t>(result.bandCount);
+        for (int chunk = begin; chunk < end; chunk++) {
+            int first = chunk * STAR_CHUNK;
+            int last = std::min(size(), first + STAR_CHUNK);
+            int count = projectStars(xs.data(), ys.data(), zs.data(), radii.data(), brightnesses.data(), first, last, projection, projected);
+
+            uint32_t* starts = &result.bandStarts[static_cast<size_t>(chunk) * startsPerChunk];
+            std::fill(starts, starts + startsPerChunk, 0u);
+            for (int s = 0; s < count; s++) {
+                bands[s] = static_cast<uint16_t>(std::clamp(static_cast<int>(projected[s].y) / bandHeight, 0, result.bandCount - 1));
+                starts[bands[s] + 1]++;
+            }
+            for (int band = 0; band < result.bandCount; band++) {
+                starts[band + 1] += starts[band];
+                next[band] = starts[band];
+            }
+
+            std::span<ProjectedStar> sorted = local.allocateArray<ProjectedStar>(count);
+            for (int s = 0; s < count; s++) {
+                sorted[next[bands[s]]++] = projected[s];
+            }
+            result.stars[chunk] = sorted.data();
+            visible.fetch_add(count, std::memory_order_relaxed);
+        }
+    }, 1);
+    result.visible = visible.load();
+    return result;
+}
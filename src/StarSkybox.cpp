@@ -0,0 +1,98 @@
+#include "StarSkybox.h"
+#include "JobSystem.h"
+
+// Standard deviation of a star's blur in pixels. The pixel nearest a star is at most
+// 0.71 pixels off it, which still gets half the star's brightness.
+const float STAR_BLUR_PIXELS = 0.6f;
+// Stars this far past a face's edge, in tangents, can still blur onto it
+const float FACE_MARGIN = 1.05f;
+
+void StarSkybox::bake(std::span<const glm::vec3> stars, float pixelsPerTangent, JobSystem& jobs) {
+    // A face spans tangents -1 to 1 and its texels are largest at its center, where
+    // they match the pixels at the center of the screen
+    faceSize = std::max(16, static_cast<int>(std::ceil(2.0f * pixelsPerTangent)));
+    texels.assign(static_cast<size_t>(6) * faceSize * faceSize, 0);
+    float halfFace = 0.5f * faceSize;
+    float sigmaRadians = STAR_BLUR_PIXELS / pixelsPerTangent;
+
+    // One face per task. A star near an edge is also blurred onto the faces next to
+    // it, so no seam cuts it off.
+    jobs.parallelFor(6, [&](int begin, int end) {
+        for (int face = begin; face < end; face++) {
+            int axis = face / 2;
+            float sign = face % 2 ? -1.0f : 1.0f;
+            uint8_t* faceTexels = &texels[static_cast<size_t>(face) * faceSize * faceSize];
+            for (const glm::vec3& star : stars) {
+                float along = sign * star[axis];
+                if (along <= 0.0f)
+                    continue;
+                float u = star[(axis + 1) % 3] / along;
+                float v = star[(axis + 2) % 3] / along;
+                if (std::abs(u) > FACE_MARGIN || std::abs(v) > FACE_MARGIN)
+                    continue;
+
+                // The face is stretched by 1 + u^2 + v^2 away from its center, the blur
+                // is too so it keeps its size on screen
+                float sigma = sigmaRadians * halfFace * (1.0f + u * u + v * v);
+                float reach = 3.0f * sigma;
+                float centerU = (u + 1.0f) * halfFace;
+                float centerV = (v + 1.0f) * halfFace;
+                int minU = std::max(0, static_cast<int>(std::floor(centerU - reach)));
+                int maxU = std::min(faceSize - 1, static_cast<int>(std::floor(centerU + reach)));
+                int minV = std::max(0, static_cast<int>(std::floor(centerV - reach)));
+                int maxV = std::min(faceSize - 1, static_cast<int>(std::floor(centerV + reach)));
+                float falloff = -0.5f / (sigma * sigma);
+                for (int y = minV; y <= maxV; y++) {
+                    float dv = y + 0.5f - centerV;
+                    for (int x = minU; x <= maxU; x++) {
+                        float du = x + 0.5f - centerU;
+                        uint8_t brightness = static_cast<uint8_t>(255.0f * std::exp((du * du + dv * dv) * falloff));
+                        uint8_t& texel = faceTexels[static_cast<size_t>(y) * faceSize + x];
+                        texel = std::max(texel, brightness);
+                    }
+                }
+            }
+        }
+    }, 1);
+
+    tilesPerSide = (faceSize + SKYBOX_TILE - 1) / SKYBOX_TILE;
+    litTiles.assign(static_cast<size_t>(6) * tilesPerSide * tilesPerSide, 0);
+    for (int face = 0; face < 6; face++) {
+        for (int y = 0; y < faceSize; y++) {
+            const uint8_t* row = &texels[(static_cast<size_t>(face) * faceSize + y) * faceSize];
+            uint8_t* tiles = &litTiles[(static_cast<size_t>(face) * tilesPerSide + y / SKYBOX_TILE) * tilesPerSide];
+            for (int x = 0; x < faceSize; x++) {
+                tiles[x / SKYBOX_TILE] |= row[x];
+            }
+        }
+    }
+}
+
+bool StarSkybox::regionEmpty(const glm::vec3 corners[4]) const {
+    // Directions map to a face through a projection, which keeps straight lines
+    // straight. With every corner on one face the whole region is on it, inside the
+    // box around the corners.
+    int face;
+    glm::vec2 low = faceTexel(corners[0], face);
+    glm::vec2 high = low;
+    for (int i = 1; i < 4; i++) {
+        int cornerFace;
+        glm::vec2 texel = faceTexel(corners[i], cornerFace);
+        if (cornerFace != face)
+            return false;
+        low = glm::min(low, texel);
+        high = glm::max(high, texel);
+    }
+    int minX = std::max(0, static_cast<int>(low.x) / SKYBOX_TILE);
+    int minY = std::max(0, static_cast<int>(low.y) / SKYBOX_TILE);
+    int maxX = std::min(tilesPerSide - 1, static_cast<int>(high.x) / SKYBOX_TILE);
+    int maxY = std::min(tilesPerSide - 1, static_cast<int>(high.y) / SKYBOX_TILE);
+    for (int y = minY; y <= maxY; y++) {
+        const uint8_t* tiles = &litTiles[(static_cast<size_t>(face) * tilesPerSide + y) * tilesPerSide];
+        for (int x = minX; x <= maxX; x++) {
+            if (tiles[x])
+                return false;
+        }
+    }
+    return true;
+}
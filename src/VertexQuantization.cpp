@@ -0,0 +1,130 @@
+#include "VertexQuantization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Octahedral codes: the unit sphere is projected onto the octahedron |x| + |y| + |z| = 1
+// and its lower half folded over the upper one, which flattens it into the square
+// [-1, 1]^2. Each of the two coordinates is stored in half of the code.
+
+static float signNotZero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static glm::vec2 octahedralProject(const glm::vec3& normal) {
+    float sum = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    glm::vec2 p(normal.x / sum, normal.y / sum);
+    if (normal.z < 0.0f)
+        p = glm::vec2((1.0f - std::abs(p.y)) * signNotZero(p.x), (1.0f - std::abs(p.x)) * signNotZero(p.y));
+    return p;
+}
+
+static glm::vec3 octahedralUnproject(float x, float y) {
+    glm::vec3 normal(x, y, 1.0f - std::abs(x) - std::abs(y));
+    float fold = std::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    return normal;
+}
+
+template <int Bits>
+static glm::vec3 decodeNormal(uint32_t code) {
+    constexpr uint32_t MAX = (1u << Bits) - 1;
+    float x = static_cast<float>(code & MAX) * (2.0f / MAX) - 1.0f;
+    float y = static_cast<float>(code >> Bits) * (2.0f / MAX) - 1.0f;
+    return octahedralUnproject(x, y);
+}
+
+// Accurate for small angles too, unlike the arc cosine of the dot product
+static float angleBetween(const glm::vec3& a, const glm::vec3& b) {
+    return std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+}
+
+// Of the four codes around the projected point, the one that decodes closest to the
+// normal. Rounding each coordinate on its own can be off by twice as much.
+template <int Bits>
+static uint32_t encodeNormal(const glm::vec3& normal, float& error) {
+    constexpr uint32_t MAX = (1u << Bits) - 1;
+    glm::vec2 p = octahedralProject(normal);
+    float fx = std::floor((std::clamp(p.x, -1.0f, 1.0f) + 1.0f) * 0.5f * MAX);
+    float fy = std::floor((std::clamp(p.y, -1.0f, 1.0f) + 1.0f) * 0.5f * MAX);
+    uint32_t best = 0;
+    error = std::numeric_limits<float>::max();
+    for (int corner = 0; corner < 4; corner++) {
+        uint32_t x = std::min(static_cast<uint32_t>(fx) + (corner & 1), MAX);
+        uint32_t y = std::min(static_cast<uint32_t>(fy) + (corner >> 1), MAX);
+        uint32_t code = x | y << Bits;
+        float cornerError = angleBetween(decodeNormal<Bits>(code), normal);
+        if (cornerError < error) {
+            error = cornerError;
+            best = code;
+        }
+    }
+    return best;
+}
+
+QuantizedVertices quantizeVertices(const std::vector<glm::vec3>& vertexBufferObject, int normalBits) {
+    QuantizedVertices quantized;
+    quantized.normalBits = normalBits;
+    size_t vertexCount = vertexBufferObject.size() / 2;
+    if (vertexCount == 0)
+        return quantized;
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+    for (size_t v = 0; v < vertexCount; v++) {
+        boundsMin = glm::min(boundsMin, vertexBufferObject[2 * v]);
+        boundsMax = glm::max(boundsMax, vertexBufferObject[2 * v]);
+    }
+    quantized.offset = boundsMin;
+    quantized.scale = (boundsMax - boundsMin) / 65535.0f;
+
+    quantized.positions.resize(3 * vertexCount);
+    if (normalBits == 16)
+        quantized.normals16.resize(vertexCount);
+    else
+        quantized.normals32.resize(vertexCount);
+
+    for (size_t v = 0; v < vertexCount; v++) {
+        const glm::vec3& position = vertexBufferObject[2 * v];
+        const glm::vec3& normal = vertexBufferObject[2 * v + 1];
+        for (int axis = 0; axis < 3; axis++) {
+            float code = quantized.scale[axis] > 0.0f ? std::round((position[axis] - boundsMin[axis]) / quantized.scale[axis]) : 0.0f;
+            quantized.positions[3 * v + axis] = static_cast<uint16_t>(std::clamp(code, 0.0f, 65535.0f));
+        }
+
+        // A zero normal has no direction to lose
+        float normalError = 0.0f;
+        bool hasDirection = glm::dot(normal, normal) > 0.0f;
+        if (normalBits == 16)
+            quantized.normals16[v] = hasDirection ? static_cast<uint16_t>(encodeNormal<8>(normal, normalError)) : 0;
+        else
+            quantized.normals32[v] = hasDirection ? encodeNormal<16>(normal, normalError) : 0;
+        quantized.normalError = std::max(quantized.normalError, hasDirection ? normalError : 0.0f);
+    }
+
+    // Measured on the decoded vertices, exactly what the vertex stage will see
+    glm::vec3 decoded[2];
+    for (size_t v = 0; v < vertexCount; v++) {
+        quantized.decode(static_cast<uint32_t>(v), 1, decoded);
+        quantized.positionError = std::max(quantized.positionError, glm::length(decoded[0] - vertexBufferObject[2 * v]));
+    }
+    return quantized;
+}
+
+void QuantizedVertices::decode(uint32_t first, uint32_t count, glm::vec3* out) const {
+    const uint16_t* position = &positions[3 * first];
+    for (uint32_t v = 0; v < count; v++, position += 3) {
+        out[2 * v] = offset + scale * glm::vec3(position[0], position[1], position[2]);
+    }
+    if (normalBits == 16) {
+        for (uint32_t v = 0; v < count; v++) {
+            out[2 * v + 1] = decodeNormal<8>(normals16[first + v]);
+        }
+    } else {
+        for (uint32_t v = 0; v < count; v++) {
+            out[2 * v + 1] = decodeNormal<16>(normals32[first + v]);
+        }
+    }
+}
@@ -2,9 +2,14 @@
 #include <cmath>
 #include <vector>
 #include <array>
-#include <sstream>
+#include <cstdio>
+#include <cstdarg>
 #include <functional>
 #include <random>
+#include <cstring>
+#include <bit>
+#include <mutex>
+#include <limits>
 
 #include "globals.h"
 #include "ObjLoader.h"
@@ -13,24 +18,128 @@
 #include "Uniform.h"
 #include "RenderingUtils.h"
 #include "Shaders.h"
-#include "planet.h"
+#include "FrameStats.h"
+#include "VisibilityBuffer.h"
+#include "HdrBuffer.h"
+#include "JobSystem.h"
+#include "PostProcess.h"
+#include "FramePipeline.h"
+#include "Material.h"
+#include "MeshRegistry.h"
+#include "LinearAllocator.h"
+#include "AllocationCounter.h"
+#include "FixedTimestep.h"
+#include "SceneGraph.h"
+#include "BodyStore.h"
+#include "BoundingVolumeHierarchy.h"
+#include "BvhBenchmark.h"
+#include "ColorBenchmark.h"
+#include "GravityBenchmark.h"
+#include "Meshlet.h"
+#include "HiZBuffer.h"
+#include "Frustum.h"
+#include "GravitySimulation.h"
+#include "AssetLoader.h"
+#include "StarSkybox.h"
+#include "StarField.h"
+#include "FastRandom.h"
 
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
 
-std::array<std::array<float, SCREEN_WIDTH>, SCREEN_HEIGHT> zbuffer;
+// Packed ARGB colors, row 0 is the bottom of the screen like the zbuffer
+using Framebuffer = std::array<std::array<Uint32, SCREEN_WIDTH>, SCREEN_HEIGHT>;
+
+// Render options toggled from the keyboard, every frame packet carries a copy
+struct RenderSettings {
+    bool hdr = false;               // Shaders write linear float colors into hdrBuffer, resolveHdr() tonemaps them
+    bool bloom = true;              // Post-processing with the emissive buffer driving the bloom pass
+    bool visibilityBuffer = false;  // Draws only record depth and (draw id, triangle id), shaded once per pixel later
+};
+
+// Everything below up to the frame packet belongs to renderFrame(), which runs for
+// one frame at a time; see FramePipeline
+std::array<std::array<Depth, SCREEN_WIDTH>, SCREEN_HEIGHT> zbuffer;
+Framebuffer* framebuffer;           // Output of the frame being rasterized
+RenderSettings renderSettings;      // Settings of the frame being rasterized
 SDL_Window* window;
 SDL_Renderer* renderer;
+SDL_Texture* framebufferTexture;
 const int* globalScreenHeight;
 const int* globalScreenWidth;
 
-Uniforms uniforms;
+JobSystem jobs;
+
+HdrBuffer hdrBuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
+ToneMapSettings toneMapSettings;
+
+// Emissive shaders also write their color into emissiveBuffer (everything else
+// writes black) to drive the bloom pass
+HdrBuffer emissiveBuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
+PostChain postChain;
+
+// resolveVisibilityBuffer() shades every visible pixel exactly once
+std::array<std::array<VisibilityId, SCREEN_WIDTH>, SCREEN_HEIGHT> visibilityBuffer;
+
+// Everything a draw needs, captured when it is submitted so it can run on any thread.
+// The mesh is only viewed, it is read by processFrameGeometry() on the main thread.
+// The screen-space triangles live in the frame's arena until the packet is reused.
+struct DrawCall {
+    MeshView mesh;
+    Uniforms uniforms;
+    Camera camera;
+    Material material;
+    std::span<const Triangle> triangles = {};
+    bool deferred = false;      // Only records visibility, shaded by resolveVisibilityBuffer()
+    int instanceGroup = -1;     // Index into instanceGroups
+};
+
+// Consecutive draws recorded by renderInstanced() that share one mesh
+struct InstanceGroup {
+    MeshView mesh;
+    Uint32 firstDraw;
+    Uint32 instanceCount;
+};
 
-// Define the type of function to store in activeShader
-using ShaderFunction = std::function<Fragment(const Fragment& fragment)>;
+// Draws recorded by render<Shader>() and renderInstanced() on the main thread for the
+// frame being built. Meshes are only viewed, whoever submits them keeps a MeshHandle
+// alive until processFrameGeometry() ran.
+std::vector<DrawCall> drawCalls;
+std::vector<InstanceGroup> instanceGroups;
+// Occluders of the frame being built, for the meshlet tests of processFrameGeometry()
+HiZBuffer hiZBuffer(SCREEN_WIDTH, SCREEN_HEIGHT);
 
-// Global variable to store active fragment shader function
-ShaderFunction activeShader;
+// Immutable snapshot of a frame, built by the main thread and rasterized by renderFrame()
+struct FramePacket {
+    Uint32 buildTicks = 0;          // SDL_GetTicks() when the main thread started building it
+    double sceneTime = 0.0;         // Simulation time the frame shows
+    double timeScale = 1.0;
+    RenderSettings settings;
+    Uniforms skyboxUniforms;        // View, projection and viewport of the background
+    const StarSkybox* skybox = nullptr;     // Null until it is baked
+    ProjectedStars starField;       // In the arena, empty until the field is generated
+    double starProjectMilliseconds = 0.0;
+    double starSplatMilliseconds = 0.0;     // Written by renderFrame()
+    Uniforms bodyUniforms;          // View, projection and viewport of the point bodies
+    std::span<const glm::vec3> bodyPoints;  // Bodies too small on screen for a mesh, in the arena
+    int bodyCount = 0;
+    int bodyMeshCount = 0;
+    double bodyUpdateMilliseconds = 0.0;
+    double bodyCullMilliseconds = 0.0;
+    double bodyRefitMilliseconds = 0.0;     // Of the BVH, including a rebuild if it took one
+    bool bodyBvhRebuilt = false;
+    BodyId pickedBody = -1;         // Last body clicked on, -1 for none
+    BodyId nearestBody = -1;        // Closest to the ship
+    float nearestDistance = 0.0f;   // From the ship to its surface
+    MeshletStats meshletStats;
+    bool gravity = false;           // Bodies come from the gravity simulation
+    double gravityBuildMilliseconds = 0.0;
+    double gravityForceMilliseconds = 0.0;
+    std::vector<DrawCall> draws;    // Geometry already processed
+    FrameArena arena{jobs};         // Transient data of the frame, reset when the packet is reused
+    Framebuffer framebuffer;        // Filled by renderFrame(), presented by the main thread
+    FrameStats stats;
+};
 
 
 bool init() {
@@ -41,6 +150,7 @@ bool init() {
 
     window = SDL_CreateWindow("Render Test", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    framebufferTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
     globalScreenHeight = &SCREEN_HEIGHT;
     globalScreenWidth = &SCREEN_HEIGHT;
 
@@ -48,79 +158,390 @@ bool init() {
 }
 
 void quit() {
+    SDL_DestroyTexture(framebufferTexture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
 }
 
 void clear() {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+    // Fill the framebuffer with opaque black
+    for (auto &row : *framebuffer) {
+        std::fill(row.begin(), row.end(), Color(0, 0, 0).pack());
+    }
     // Fill the z-buffer
     for (auto &row : zbuffer) {
-        std::fill(row.begin(), row.end(), 99999.0f);
+        std::fill(row.begin(), row.end(), DEPTH_CLEAR);
+    }
+    if (renderSettings.hdr)
+        hdrBuffer.clear();
+    if (renderSettings.bloom)
+        emissiveBuffer.clear();
+    if (renderSettings.visibilityBuffer) {
+        for (auto &row : visibilityBuffer) {
+            std::fill(row.begin(), row.end(), VISIBILITY_EMPTY);
+        }
     }
 }
 
+// Stores a shaded color in whichever color target the frame renders to
+inline void writeColor(int x, int y, const ColorF& color, bool emissive = false) {
+    if (renderSettings.hdr)
+        hdrBuffer.write(x, y, color);
+    else
+        (*framebuffer)[y][x] = color.pack();
+    if (renderSettings.bloom)
+        emissiveBuffer.write(x, y, emissive ? color : ColorF(0, 0, 0));
+}
+
 void point(Fragment fragment) {
     if (isInsideScreen(fragment, SCREEN_WIDTH, SCREEN_HEIGHT) && 
-        fragment.z < zbuffer[fragment.y][fragment.x]) {
+        quantizeDepth(fragment.z) < zbuffer[fragment.y][fragment.x]) {
         // Draw the fragment on screen
-        drawPoint(renderer, fragment.x, fragment.y, fragment.color);
+        writeColor(fragment.x, fragment.y, fragment.color);
         // Update the zbuffer for value for this position
-        zbuffer[fragment.y][fragment.x] = fragment.z;
+        zbuffer[fragment.y][fragment.x] = quantizeDepth(fragment.z);
+        visibilityBuffer[fragment.y][fragment.x] = VISIBILITY_EMPTY;
     }
 }
 
-void render(std::vector<glm::vec3> vertexBufferObject, Camera camera) {
-    // 1. Vertex Shader
-    std::vector<Vertex> transformedVertices;
-    for (int i = 0; i < vertexBufferObject.size(); i += 2) {
-        Vertex vertex = Vertex(vertexBufferObject[i], vertexBufferObject[i + 1]);
-        Vertex transformedVertex = vertexShader(vertex, uniforms);
-        transformedVertices.push_back(transformedVertex);
+void present(const Framebuffer& framebuffer) {
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(framebufferTexture, NULL, &pixels, &pitch) == 0) {
+        // Framebuffer rows grow upwards, texture rows grow downwards
+        for (int y = 0; y < SCREEN_HEIGHT; y++) {
+            Uint8* row = static_cast<Uint8*>(pixels) + (SCREEN_HEIGHT - 1 - y) * pitch;
+            std::memcpy(row, framebuffer[y].data(), SCREEN_WIDTH * sizeof(Uint32));
+        }
+        SDL_UnlockTexture(framebufferTexture);
     }
+    SDL_RenderCopy(renderer, framebufferTexture, NULL, NULL);
+    SDL_RenderPresent(renderer);
+}
+
+// Depth tests a rasterized block, shades the surviving pixels and writes them out
+template <typename Shader>
+void shadeBlock(FragmentBlock<Shader::interpolants>& block, const Shader& shader, FrameStats& stats) {
+    Uint64 mask = block.mask;
+    for (Uint64 bits = mask; bits != 0; bits &= bits - 1) {
+        int lane = std::countr_zero(bits);
+        if (block.depth[lane] >= zbuffer[block.pixelY(lane)][block.pixelX(lane)])
+            mask &= ~(Uint64(1) << lane);
+    }
+    if (mask == 0)
+        return;
+    block.mask = mask;
+
+    ColorF colors[BLOCK_PIXELS];
+    Uint64 shadeStart = SDL_GetPerformanceCounter();
+    shader(block, colors);
+    stats.shadeCounter += SDL_GetPerformanceCounter() - shadeStart;
+    stats.shadedPixels += std::popcount(mask);
+
+    for (Uint64 bits = mask; bits != 0; bits &= bits - 1) {
+        int lane = std::countr_zero(bits);
+        int x = block.pixelX(lane);
+        int y = block.pixelY(lane);
+        writeColor(x, y, colors[lane], isEmissive<Shader>);
+        zbuffer[y][x] = block.depth[lane];
+        // A forward draw may cover a pixel an earlier deferred draw had won
+        visibilityBuffer[y][x] = VISIBILITY_EMPTY;
+    }
+}
 
-    // 2. Primitive Assembly
-    std::vector<std::vector<Vertex>> triangles = primitiveAssembly(transformedVertices);
+// Rebuilds the interpolants of the pixels in mask, which all belong to this draw, and shades them
+template <typename Shader>
+void resolveDeferredTile(const DrawCall& draw, int tileX, int tileY, Uint64 mask, const VisibilityId* ids, FrameStats& stats) {
+    Shader shader;
+    FragmentBlock<Shader::interpolants> block;
+    block.x = tileX;
+    block.y = tileY;
+    block.mask = mask;
 
-    // 3. Rasterization
-    std::vector<Fragment> fragments;
-    for (std::vector<Vertex> triangle : triangles) {
-        std::vector<Fragment> rasterizedTriangle = getTriangleFragments(triangle[0], triangle[1], triangle[2], SCREEN_WIDTH, SCREEN_HEIGHT, camera);
+    for (Uint64 bits = mask; bits != 0; bits &= bits - 1) {
+        int lane = std::countr_zero(bits);
+        int x = block.pixelX(lane);
+        int y = block.pixelY(lane);
+        const Triangle& triangle = draw.triangles[visibilityTriangleId(ids[lane])];
 
-        fragments.insert(
-            fragments.end(),
-            rasterizedTriangle.begin(),
-            rasterizedTriangle.end()
-        );
+        glm::vec3 barCoords = barycentricCoordinates(glm::vec3(x, y, 0), triangle[0].position, triangle[1].position, triangle[2].position);
+        glm::vec3 normal = interpolateNormal(triangle[0], triangle[1], triangle[2], barCoords);
+        block.depth[lane] = zbuffer[y][x];
+        interpolateLane(block, lane, triangle[0], triangle[1], triangle[2], barCoords, normal);
     }
-    
-    // 4. Fragment Shader
-    for (Fragment fragment : fragments) {
-        Fragment transformedFragment = activeShader(fragment);
-        point(transformedFragment);
+
+    ColorF colors[BLOCK_PIXELS];
+    Uint64 shadeStart = SDL_GetPerformanceCounter();
+    shader(block, colors);
+    stats.shadeCounter += SDL_GetPerformanceCounter() - shadeStart;
+    stats.shadedPixels += std::popcount(mask);
+
+    for (Uint64 bits = mask; bits != 0; bits &= bits - 1) {
+        int lane = std::countr_zero(bits);
+        writeColor(block.pixelX(lane), block.pixelY(lane), colors[lane], isEmissive<Shader>);
     }
 }
 
-float generateRandomNormal(float mean = 0.0f, float stddev = 1.0f) {
-    // Set up a random engine and distribution
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::normal_distribution<float> distribution(mean, stddev);
+// Second pass of visibility buffer mode: shades each tile one draw (material) at a time.
+// Tile rows are independent and split across the thread pool.
+void resolveVisibilityBuffer(const std::vector<DrawCall>& draws, FrameStats& stats) {
+    std::mutex statsMutex;
+    int tileRows = (SCREEN_HEIGHT + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    jobs.parallelFor(tileRows, [&](int beginRow, int endRow) {
+        FrameStats bandStats;
+        for (int tileY = beginRow * BLOCK_SIZE; tileY < endRow * BLOCK_SIZE; tileY += BLOCK_SIZE) {
+            for (int tileX = 0; tileX < SCREEN_WIDTH; tileX += BLOCK_SIZE) {
+                VisibilityId ids[BLOCK_PIXELS];
+                Uint64 remaining = 0;
+                for (int lane = 0; lane < BLOCK_PIXELS; lane++) {
+                    int x = tileX + lane % BLOCK_SIZE;
+                    int y = tileY + lane / BLOCK_SIZE;
+                    ids[lane] = isInsideScreen(x, y, SCREEN_WIDTH, SCREEN_HEIGHT) ? visibilityBuffer[y][x] : VISIBILITY_EMPTY;
+                    if (ids[lane] != VISIBILITY_EMPTY)
+                        remaining |= Uint64(1) << lane;
+                }
+
+                while (remaining != 0) {
+                    Uint32 drawId = visibilityDrawId(ids[std::countr_zero(remaining)]);
+                    Uint64 mask = 0;
+                    for (Uint64 bits = remaining; bits != 0; bits &= bits - 1) {
+                        int lane = std::countr_zero(bits);
+                        if (visibilityDrawId(ids[lane]) == drawId)
+                            mask |= Uint64(1) << lane;
+                    }
+                    remaining &= ~mask;
 
-    // Generate and return a random value
-    return distribution(gen);
+                    const DrawCall& draw = draws[drawId];
+                    draw.material.resolve(draw, tileX, tileY, mask, ids, bandStats);
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.addShading(bandStats);
+    });
+}
+
+// Whether a draw only records visibility this frame
+bool isDeferred(const DrawCall& draw, Uint32 drawId, const RenderSettings& settings) {
+    return settings.visibilityBuffer && drawId < VISIBILITY_MAX_DRAWS && draw.triangles.size() <= VISIBILITY_MAX_TRIANGLES;
+}
+
+// Tests every meshlet of a mesh for one draw, returns the triangles that survive
+size_t cullMeshlets(std::span<const Meshlet> meshlets, const DrawCall& draw, std::span<bool> visible, MeshletStats& stats) {
+    MeshletCuller culler(draw.uniforms, draw.camera.viewDirection, &hiZBuffer);
+    size_t triangleCount = 0;
+    for (size_t m = 0; m < meshlets.size(); m++) {
+        visible[m] = culler.visible(meshlets[m], stats);
+        if (visible[m])
+            triangleCount += meshlets[m].triangleCount;
+    }
+    return triangleCount;
+}
+
+// 1. Vertex Shader and 2. Primitive Assembly of a submitted draw, for the meshlets that
+// pass the culling tests. Every three consecutive vertices form a triangle, so the
+// vertex shader writes straight into the triangles.
+void processGeometry(DrawCall& draw, Uint32 drawId, const RenderSettings& settings, FrameArena& arena, MeshletStats& stats) {
+    LinearAllocator& allocator = arena.local();
+    std::span<const Meshlet> meshlets = draw.mesh.meshlets;
+    std::span<bool> visible = allocator.allocateArray<bool>(meshlets.size());
+    std::span<Triangle> triangles = allocator.allocateArray<Triangle>(cullMeshlets(meshlets, draw, visible, stats));
+
+    VertexTransform transform(draw.uniforms);
+    glm::vec3 decoded[2 * 3 * MESHLET_MAX_TRIANGLES];
+    Triangle* out = triangles.data();
+    for (size_t m = 0; m < meshlets.size(); m++) {
+        if (!visible[m])
+            continue;
+        const glm::vec3* vertices = draw.mesh.meshletVertices(meshlets[m], decoded);
+        for (uint32_t v = 0; v < meshlets[m].triangleCount * 3; v++) {
+            out[v / 3][v % 3] = vertexShader(Vertex(vertices[2 * v], vertices[2 * v + 1]), transform);
+        }
+        out += meshlets[m].triangleCount;
+    }
+
+    draw.triangles = triangles;
+    draw.deferred = isDeferred(draw, drawId, settings);
+}
+
+// Vertex stage of instances [begin, end) of a group. Every instance tests the meshlets
+// first, then the shared mesh is read one meshlet at a time and every instance that
+// sees it transforms it, so each vertex is fetched from memory once instead of once
+// per instance while the meshlet stays in L1.
+void processInstances(const InstanceGroup& group, int begin, int end, const RenderSettings& settings, FrameArena& arena, MeshletStats& stats) {
+    std::span<const Meshlet> meshlets = group.mesh.meshlets;
+    int count = end - begin;
+
+    LinearAllocator& allocator = arena.local();
+    std::span<VertexTransform> transforms = allocator.allocateArray<VertexTransform>(count);
+    std::span<Triangle*> outputs = allocator.allocateArray<Triangle*>(count);
+    std::span<bool> visible = allocator.allocateArray<bool>(count * meshlets.size());
+    for (int i = 0; i < count; i++) {
+        DrawCall& draw = drawCalls[group.firstDraw + begin + i];
+        new (&transforms[i]) VertexTransform(draw.uniforms);
+        std::span<Triangle> triangles = allocator.allocateArray<Triangle>(cullMeshlets(meshlets, draw, visible.subspan(i * meshlets.size(), meshlets.size()), stats));
+        draw.triangles = triangles;
+        outputs[i] = triangles.data();
+    }
+
+    glm::vec3 decoded[2 * 3 * MESHLET_MAX_TRIANGLES];
+    for (size_t m = 0; m < meshlets.size(); m++) {
+        // Quantized meshlets are decoded once for every instance, and only if one sees them
+        const glm::vec3* vertices = nullptr;
+        uint32_t vertexCount = meshlets[m].triangleCount * 3;
+        for (int i = 0; i < count; i++) {
+            if (!visible[i * meshlets.size() + m])
+                continue;
+            if (!vertices)
+                vertices = group.mesh.meshletVertices(meshlets[m], decoded);
+            const VertexTransform& transform = transforms[i];
+            Triangle* out = outputs[i];
+            for (uint32_t v = 0; v < vertexCount; v++) {
+                out[v / 3][v % 3] = vertexShader(Vertex(vertices[2 * v], vertices[2 * v + 1]), transform);
+            }
+            outputs[i] += meshlets[m].triangleCount;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        Uint32 drawId = group.firstDraw + begin + i;
+        DrawCall& draw = drawCalls[drawId];
+        draw.deferred = isDeferred(draw, drawId, settings);
+    }
 }
 
+// Geometry of everything recorded for the frame: plain draws one per task, instance
+// groups split into runs of instances. All of it is allocated from arena. hiZBuffer
+// must hold the frame's occluders.
+void processFrameGeometry(const RenderSettings& settings, FrameArena& arena, MeshletStats& stats) {
+    std::mutex statsMutex;
+    jobs.parallelFor(static_cast<int>(drawCalls.size()), [&](int begin, int end) {
+        MeshletStats taskStats;
+        for (int i = begin; i < end; i++) {
+            if (drawCalls[i].instanceGroup < 0)
+                processGeometry(drawCalls[i], i, settings, arena, taskStats);
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.add(taskStats);
+    }, 1);
+
+    for (const InstanceGroup& group : instanceGroups) {
+        jobs.parallelFor(static_cast<int>(group.instanceCount), [&](int begin, int end) {
+            MeshletStats taskStats;
+            processInstances(group, begin, end, settings, arena, taskStats);
+            std::lock_guard<std::mutex> lock(statsMutex);
+            stats.add(taskStats);
+        });
+    }
+    instanceGroups.clear();
+}
+
+// Rasterizes the part of a draw that falls in rows [minY, maxY]
+template <typename Shader>
+void rasterizeDraw(const DrawCall& draw, Uint32 drawId, int minY, int maxY, FrameStats& stats) {
+    // 3. Visibility pass only, shading waits for resolveVisibilityBuffer()
+    if (draw.deferred) {
+        for (Uint32 t = 0; t < draw.triangles.size(); t++) {
+            const Triangle& triangle = draw.triangles[t];
+            rasterizeTriangleVisibility(triangle[0], triangle[1], triangle[2], SCREEN_WIDTH, SCREEN_HEIGHT, draw.camera, minY, maxY, [&](int x, int y, Depth depth) {
+                if (depth < zbuffer[y][x]) {
+                    zbuffer[y][x] = depth;
+                    visibilityBuffer[y][x] = packVisibilityId(drawId, t);
+                }
+            });
+        }
+        return;
+    }
+
+    // 3. Rasterization and 4. Fragment Shader, one block of pixels at a time
+    Shader shader;
+    FragmentBlock<Shader::interpolants> block;
+    for (const Triangle& triangle : draw.triangles) {
+        rasterizeTriangleBlocks<Shader::interpolants>(triangle[0], triangle[1], triangle[2], SCREEN_WIDTH, SCREEN_HEIGHT, draw.camera, minY, maxY, block,
+            [&](FragmentBlock<Shader::interpolants>& block) { shadeBlock(block, shader, stats); });
+    }
+}
+
+// Instantiated once per fragment shader so the shader and the interpolants it
+// reads are resolved at compile time; see Material.h
+template <typename Shader>
+Material material() {
+    return Material{rasterizeDraw<Shader>, resolveDeferredTile<Shader>};
+}
+
+// Only records the draw, the frame packet carries it to renderFrame()
+template <typename Shader>
+void render(MeshView mesh, const Uniforms& uniforms, const Camera& camera) {
+    drawCalls.push_back(DrawCall{mesh, uniforms, camera, material<Shader>()});
+}
+
+// Records one draw per instance of a shared mesh. uniforms supplies view, projection
+// and viewport, each instance its model matrix and material.
+void renderInstanced(MeshView mesh, const Uniforms& uniforms, const Camera& camera, const std::vector<Instance>& instances) {
+    if (instances.empty())
+        return;
+    int group = static_cast<int>(instanceGroups.size());
+    instanceGroups.push_back(InstanceGroup{mesh, static_cast<Uint32>(drawCalls.size()), static_cast<Uint32>(instances.size())});
+    for (const Instance& instance : instances) {
+        Uniforms instanceUniforms = uniforms;
+        instanceUniforms.model = instance.model;
+        drawCalls.push_back(DrawCall{{}, instanceUniforms, camera, instance.material, {}, false, group});
+    }
+}
+
+// Rasterizes the draws of a frame. The screen is split into bands of block rows and
+// every band rasterizes all draws in submission order. Each pixel sees the same depth
+// tests and writes in the same order as a serial run, so the output is identical.
+void executeDraws(const std::vector<DrawCall>& draws, FrameStats& stats) {
+    std::mutex statsMutex;
+    int tileRows = (SCREEN_HEIGHT + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    jobs.parallelFor(tileRows, [&](int beginRow, int endRow) {
+        FrameStats bandStats;
+        int minY = beginRow * BLOCK_SIZE;
+        int maxY = std::min(endRow * BLOCK_SIZE, SCREEN_HEIGHT) - 1;
+        for (Uint32 i = 0; i < draws.size(); i++) {
+            draws[i].material.rasterize(draws[i], i, minY, maxY, bandStats);
+        }
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats.addShading(bandStats);
+    });
+}
+
+// Simulation rate of the camera and the scene clock
+const double SIMULATION_STEP = 1.0 / 60.0;
+const double MIN_TIME_SCALE = 1.0 / 64.0;
+const double MAX_TIME_SCALE = 1024.0;
+
+// Moves the camera for one simulation step from the keys held down
+void moveCamera(Camera& camera, const Uint8* keys, float seconds) {
+    const float movementSpeed = 45.0f;  // Units per second
+    const float rotationSpeed = 60.0f;  // Degrees per second
+    if (keys[SDL_SCANCODE_W])
+        camera.MoveForward(movementSpeed * seconds);
+    if (keys[SDL_SCANCODE_S])
+        camera.MoveBackward(movementSpeed * seconds);
+    if (keys[SDL_SCANCODE_D])
+        camera.MoveRight(movementSpeed * seconds);
+    if (keys[SDL_SCANCODE_A])
+        camera.MoveLeft(movementSpeed * seconds);
+    // Orbit the camera left or right
+    if (keys[SDL_SCANCODE_Q])
+        camera.Rotate(rotationSpeed * seconds, 0.0f);
+    if (keys[SDL_SCANCODE_E])
+        camera.Rotate(-rotationSpeed * seconds, 0.0f);
+}
+
+// Directions of the skybox's stars. Seeded, so every run gets the same sky.
 std::vector<glm::vec3> generateStars() {
     int amount = 1000;
     float radius = 500.0f;
+    FastRandom random(7);
     std::vector<glm::vec3> starVertices;
     for (int i = 0; i < amount; i++) {
-        float x = generateRandomNormal();
-        float y = generateRandomNormal();
-        float z = generateRandomNormal();
+        float x = random.normal();
+        float y = random.normal();
+        float z = random.normal();
         if (x == 0 && y == 0 && z == 0) {
             i--;
             continue;
@@ -132,169 +553,776 @@ std::vector<glm::vec3> generateStars() {
     return starVertices;
 }
 
-void drawStars(const std::vector<glm::vec3>& starVertices, const Uniforms& uniforms) {
-    for (auto& star : starVertices) {
-        // Apply transformations to the star using the matrices from the uniforms
-        glm::vec4 clipSpaceVertex = uniforms.projection * uniforms.view * uniforms.model * glm::vec4(star, 1.0f);
-        // Perspective divide
+// Background of the frame, before any geometry: the skybox looked up along every
+// pixel's view direction. Blocks of pixels whose directions all fall on dark tiles are
+// skipped, the rest is looked up pixel by pixel, a fixed direction step apart along a
+// row. Rows of blocks run in parallel. Only colors are written, depth stays clear.
+void drawSkybox(const StarSkybox& skybox, const Uniforms& uniforms) {
+    // Camera space direction through a pixel center, rotated into world space
+    glm::mat3 cameraToWorld = glm::transpose(glm::mat3(uniforms.view));
+    float unitsPerPixelX = 1.0f / (uniforms.projection[0][0] * uniforms.viewport[0][0]);
+    float unitsPerPixelY = 1.0f / (uniforms.projection[1][1] * uniforms.viewport[1][1]);
+    glm::vec3 columnStep = cameraToWorld * glm::vec3(unitsPerPixelX, 0.0f, 0.0f);
+    glm::vec3 rowStep = cameraToWorld * glm::vec3(0.0f, unitsPerPixelY, 0.0f);
+    glm::vec3 origin = cameraToWorld * glm::vec3((0.5f - uniforms.viewport[3][0]) * unitsPerPixelX, (0.5f - uniforms.viewport[3][1]) * unitsPerPixelY, -1.0f);
+
+    const int BLOCK = SKYBOX_TILE;
+    jobs.parallelFor((SCREEN_HEIGHT + BLOCK - 1) / BLOCK, [&](int begin, int end) {
+        for (int blockY = begin; blockY < end; blockY++) {
+            int minY = blockY * BLOCK;
+            int maxY = std::min(minY + BLOCK, SCREEN_HEIGHT) - 1;
+            for (int minX = 0; minX < SCREEN_WIDTH; minX += BLOCK) {
+                int maxX = std::min(minX + BLOCK, SCREEN_WIDTH) - 1;
+                glm::vec3 corners[4] = {
+                    origin + columnStep * static_cast<float>(minX) + rowStep * static_cast<float>(minY),
+                    origin + columnStep * static_cast<float>(maxX) + rowStep * static_cast<float>(minY),
+                    origin + columnStep * static_cast<float>(minX) + rowStep * static_cast<float>(maxY),
+                    origin + columnStep * static_cast<float>(maxX) + rowStep * static_cast<float>(maxY),
+                };
+                if (skybox.regionEmpty(corners))
+                    continue;
+                for (int y = minY; y <= maxY; y++) {
+                    glm::vec3 direction = origin + columnStep * static_cast<float>(minX) + rowStep * static_cast<float>(y);
+                    for (int x = minX; x <= maxX; x++, direction += columnStep) {
+                        uint8_t brightness = skybox.sample(direction);
+                        if (brightness > 0)
+                            writeColor(x, y, ColorF(brightness, brightness, brightness));
+                    }
+                }
+            }
+        }
+    });
+}
+
+// Indices into the body mesh and material tables of main()
+enum BodyMesh : uint16_t {
+    BODY_MESH_SPHERE,
+    BODY_MESH_ROCK,
+    BODY_MESH_COUNT
+};
+enum BodyMaterial : uint16_t {
+    BODY_MATERIAL_SUN,
+    BODY_MATERIAL_EARTH,
+    BODY_MATERIAL_MOON,
+    BODY_MATERIAL_GAS_GIANT,
+    BODY_MATERIAL_RED_PLANET,
+    BODY_MATERIAL_COUNT
+};
+
+// Point stars around the system, far enough out that they sit behind every planet
+const int STAR_FIELD_COUNT = 1000000;
+const float STAR_FIELD_INNER_RADIUS = 1500.0f;
+const float STAR_FIELD_OUTER_RADIUS = 6000.0f;
+const uint64_t STAR_FIELD_SEED = 2024;
+
+const int ASTEROID_COUNT = 100000;
+// Asteroids smaller than this on screen are points, and at most this many get a mesh
+const float ASTEROID_LOD_PIXELS = 2.0f;
+const size_t MAX_ASTEROID_MESHES = 128;
+
+// Asteroids between the gas giant and the red planet. Orbits slow down with distance
+// like Kepler's third law. Seeded, so every run gets the same belt.
+void addAsteroidBelt(BodyStore& bodies, int count, uint16_t center, float boundingRadius) {
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> height(0.0f, 2.0f);
+    for (int i = 0; i < count; i++) {
+        BodyDesc asteroid;
+        asteroid.orbitRadius = 135.0f + 30.0f * unit(generator);
+        asteroid.orbitSpeed = 0.25f * std::pow(150.0f / asteroid.orbitRadius, 1.5f) * (0.9f + 0.2f * unit(generator));
+        asteroid.orbitPhase = 6.2831853f * unit(generator);
+        asteroid.height = height(generator);
+        asteroid.spinSpeed = 4.0f * unit(generator) - 2.0f;
+        asteroid.scale = 0.2f + unit(generator);
+        asteroid.boundingRadius = boundingRadius;
+        asteroid.lodPixels = ASTEROID_LOD_PIXELS;
+        asteroid.mass = 0.001f;
+        asteroid.center = center;
+        asteroid.material = BODY_MATERIAL_MOON;
+        asteroid.mesh = BODY_MESH_ROCK;
+        bodies.add(asteroid);
+    }
+}
+
+// Longest step of the gravity mode in scene seconds, and the steps it may take per frame
+// before it falls behind the scene clock
+const double MAX_GRAVITY_STEP = 1.0 / 30.0;
+const int MAX_GRAVITY_STEPS_PER_FRAME = 2;
+
+// Starts the gravity mode from where the bodies are now, each on a circular orbit around
+// its center in the direction it was going. Center 0 is the origin the sun sits at,
+// center i + 1 is planet i, see main(). The sun takes the recoil of everything else, so
+// the system as a whole stays put.
+void startGravity(const BodyStore& bodies, GravitySimulation& gravity) {
+    std::vector<glm::vec3> velocities(bodies.size(), glm::vec3(0));
+    glm::vec3 momentum(0);
+    for (BodyId body = 0; body < bodies.size(); body++) {
+        int center = bodies.center(body);
+        BodyId centerBody = center > 0 ? center - 1 : 0;
+        glm::vec3 offset = bodies.position(body) - (center > 0 ? bodies.position(centerBody) : glm::vec3(0));
+        float radius = std::sqrt(offset.x * offset.x + offset.z * offset.z);
+        if (center > 0)
+            velocities[body] = velocities[centerBody];
+        if (radius > 0.0f && bodies.orbitSpeed(body) != 0.0f) {
+            float speed = std::sqrt(gravity.gravitationalConstant * bodies.mass(centerBody) / glm::length(offset));
+            glm::vec3 direction = glm::vec3(-offset.z, 0.0f, offset.x) / radius;
+            velocities[body] += direction * (bodies.orbitSpeed(body) > 0.0f ? speed : -speed);
+        }
+        if (body > 0)
+            momentum += velocities[body] * bodies.mass(body);
+    }
+    velocities[0] = -momentum / bodies.mass(0);
+
+    gravity.clear();
+    for (BodyId body = 0; body < bodies.size(); body++) {
+        gravity.add(bodies.position(body), velocities[body], bodies.mass(body));
+    }
+}
+
+// Ray from the near plane through a window pixel, y counted from the top like mouse events
+void pixelRay(const Uniforms& uniforms, int x, int y, glm::vec3& origin, glm::vec3& direction) {
+    glm::mat4 inverseViewProjection = glm::inverse(uniforms.projection * uniforms.view);
+    float ndcX = 2.0f * (x + 0.5f) / SCREEN_WIDTH - 1.0f;
+    float ndcY = 1.0f - 2.0f * (y + 0.5f) / SCREEN_HEIGHT;
+    glm::vec4 near = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 far = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    origin = glm::vec3(near) / near.w;
+    direction = glm::normalize(glm::vec3(far) / far.w - origin);
+}
+
+// Bodies too small on screen for their mesh, depth tested against the meshes
+void drawBodyPoints(std::span<const glm::vec3> points, const Uniforms& uniforms) {
+    const Color rockColor(150, 140, 130);
+    glm::mat4 viewProjection = uniforms.projection * uniforms.view;
+    for (const glm::vec3& position : points) {
+        glm::vec4 clipSpaceVertex = viewProjection * glm::vec4(position, 1.0f);
         glm::vec3 ndcVertex = glm::vec3(clipSpaceVertex) / clipSpaceVertex.w;
-        // Apply the viewport transform
-        glm::vec4 screenStar = uniforms.viewport * glm::vec4(ndcVertex, 1.0f);
-
-        Fragment starFragment{
-            glm::vec3(screenStar.x, screenStar.y, 9999.0f),
-            Color(),
-            1.0f,
-            glm::vec3(screenStar),
-            star
-        };
-        point(starFragment);
+        glm::vec4 screenPoint = uniforms.viewport * glm::vec4(ndcVertex, 1.0f);
+        point(Fragment(screenPoint.x, screenPoint.y, screenPoint.z, rockColor));
+    }
+}
+
+// One star over rows [minY, maxY] with a depth test: the pixel it is in, or a disc
+// with edges faded by how much of each pixel it covers
+void splatStar(const ProjectedStar& star, int minY, int maxY) {
+    Depth depth = quantizeDepth(star.z);
+    auto plot = [&](int x, int y, float brightness) {
+        if (depth < zbuffer[y][x]) {
+            writeColor(x, y, ColorF(brightness, brightness, brightness));
+            zbuffer[y][x] = depth;
+            visibilityBuffer[y][x] = VISIBILITY_EMPTY;
+        }
+    };
+
+    if (star.radius <= 0.5f) {
+        int x = static_cast<int>(std::floor(star.x));
+        int y = static_cast<int>(std::floor(star.y));
+        if (x >= 0 && x < SCREEN_WIDTH && y >= minY && y <= maxY)
+            plot(x, y, star.brightness);
+        return;
+    }
+    int minX = std::max(0, static_cast<int>(std::floor(star.x - star.radius)));
+    int maxX = std::min(SCREEN_WIDTH - 1, static_cast<int>(std::floor(star.x + star.radius)));
+    int firstY = std::max(minY, static_cast<int>(std::floor(star.y - star.radius)));
+    int lastY = std::min(maxY, static_cast<int>(std::floor(star.y + star.radius)));
+    for (int y = firstY; y <= lastY; y++) {
+        float dy = y + 0.5f - star.y;
+        for (int x = minX; x <= maxX; x++) {
+            float dx = x + 0.5f - star.x;
+            float coverage = std::min(1.0f, star.radius + 0.5f - std::sqrt(dx * dx + dy * dy));
+            if (coverage > 0.0f)
+                plot(x, y, star.brightness * coverage);
+        }
     }
 }
 
-int main() {
+// Splats the projected star field, one band of rows per task. A star reaches at most
+// into the bands next to its own, so every band also goes through their stars and
+// clips them to its rows. A pixel sees its stars in the same order however the bands
+// are split between workers.
+void drawStarField(const ProjectedStars& stars) {
+    int chunkCount = static_cast<int>(stars.stars.size());
+    jobs.parallelFor(stars.bandCount, [&](int begin, int end) {
+        for (int band = begin; band < end; band++) {
+            int minY = band * stars.bandHeight;
+            int maxY = std::min(minY + stars.bandHeight, SCREEN_HEIGHT) - 1;
+            for (int source = std::max(0, band - 1); source <= std::min(stars.bandCount - 1, band + 1); source++) {
+                for (int chunk = 0; chunk < chunkCount; chunk++) {
+                    for (const ProjectedStar& star : stars.band(chunk, source)) {
+                        splatStar(star, minY, maxY);
+                    }
+                }
+            }
+        }
+    }, 1);
+}
+
+// Text rebuilt every frame, like the window title, formatted into a fixed buffer so it
+// doesn't touch the heap. What doesn't fit is cut off.
+struct TextBuffer {
+    char text[1024] = "";
+    size_t length = 0;
+
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    void append(const char* format, ...) {
+        if (length + 1 >= sizeof(text))
+            return;
+        va_list args;
+        va_start(args, format);
+        int written = std::vsnprintf(text + length, sizeof(text) - length, format, args);
+        va_end(args);
+        if (written > 0)
+            length = std::min(sizeof(text) - 1, length + static_cast<size_t>(written));
+    }
+};
+
+// Back half of a frame, runs as a job of the frame pipeline
+void renderFrame(FramePacket& packet) {
+    renderSettings = packet.settings;
+    framebuffer = &packet.framebuffer;
+    packet.stats.reset();
+
+    // Clear the buffer
+    clear();
+
+    if (packet.skybox)
+        drawSkybox(*packet.skybox, packet.skyboxUniforms);
+
+    // Rasterize and shade everything the main thread submitted
+    executeDraws(packet.draws, packet.stats);
+    drawBodyPoints(packet.bodyPoints, packet.bodyUniforms);
+    Uint64 starStart = SDL_GetPerformanceCounter();
+    drawStarField(packet.starField);
+    packet.starSplatMilliseconds = FrameStats::milliseconds(SDL_GetPerformanceCounter() - starStart);
+
+    // Shade what the visibility pass kept
+    if (renderSettings.visibilityBuffer)
+        resolveVisibilityBuffer(packet.draws, packet.stats);
+
+    // Post-processing over the scene color
+    if (renderSettings.bloom) {
+        PostTarget postTarget;
+        postTarget.hdr = renderSettings.hdr ? &hdrBuffer : nullptr;
+        postTarget.ldr = packet.framebuffer[0].data();
+        postTarget.ldrStride = SCREEN_WIDTH;
+        postTarget.emissive = &emissiveBuffer;
+        postTarget.width = SCREEN_WIDTH;
+        postTarget.height = SCREEN_HEIGHT;
+        postChain.run(postTarget, jobs, packet.stats);
+    }
+
+    // Tonemap the HDR target into the framebuffer
+    if (renderSettings.hdr) {
+        Uint64 resolveStart = SDL_GetPerformanceCounter();
+        resolveHdr(hdrBuffer, toneMapSettings, packet.framebuffer[0].data(), SCREEN_WIDTH, jobs);
+        packet.stats.resolveCounter += SDL_GetPerformanceCounter() - resolveStart;
+    }
+
+    packet.stats.workerCount = jobs.threadCount();
+    packet.stats.workerWindowNanoseconds = jobs.takeCounters(packet.stats.workers);
+}
+
+int main(int argc, char* argv[]) {
+    // --check-allocations repeats the steady state allocation check below every
+    // ALLOCATION_CHECK_INTERVAL frames and exits with 1 if any of them failed
+    bool checkAllocationsRepeatedly = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--check-allocations") == 0)
+            checkAllocationsRepeatedly = true;
+
+        // Times the body BVH over the asteroid belt against brute force, then exits
+        if (std::strcmp(argv[i], "--benchmark-bvh") == 0) {
+            BodyStore belt;
+            addAsteroidBelt(belt, ASTEROID_COUNT, 0, 1.0f);
+            glm::vec3 origin(0.0f);
+            return benchmarkBvh(belt, std::span<const glm::vec3>(&origin, 1), createProjectionMatrix(SCREEN_WIDTH, SCREEN_HEIGHT), jobs) ? 0 : 1;
+        }
+
+        // Times gravity steps from 10k to 1M bodies and checks they don't depend on the
+        // thread count, then exits
+        if (std::strcmp(argv[i], "--benchmark-gravity") == 0)
+            return benchmarkGravity(jobs) ? 0 : 1;
+
+        // Times the planet shaders' color math on the old scalar Color, Color and
+        // ColorF, then exits
+        if (std::strcmp(argv[i], "--benchmark-color") == 0)
+            return benchmarkColor() ? 0 : 1;
+    }
+
+    // Every asset is read or generated by its own job, started before the window is
+    // created so they overlap it. Mesh vertices are stored quantized, 8 bytes instead
+    // of 24, unless that moves them too far. The loader is declared after what its
+    // jobs write to, so it waits for them before any of it goes away.
+    MeshRegistry meshes(VertexCompression{.enabled = true, .normalBits = 16});
+    MeshHandle sphereMesh;
+    MeshHandle rockMesh;
+    MeshHandle shipMesh;
+    StarSkybox skybox;
+    StarField starField;
+    AssetLoader assets(jobs);
+    assets.load("sphere.obj", true, [&] { sphereMesh = meshes.load("../models/sphere.obj"); return sphereMesh != nullptr; });
+    assets.load("cube.obj", true, [&] { rockMesh = meshes.load("../models/cube.obj"); return rockMesh != nullptr; });
+    AssetId shipAsset = assets.load("Lab3_Ship.obj", false, [&] { shipMesh = meshes.load("../models/Lab3_Ship.obj"); return shipMesh != nullptr; });
+    float pixelsPerTangent = createProjectionMatrix(SCREEN_WIDTH, SCREEN_HEIGHT)[1][1] * SCREEN_HEIGHT * 0.5f;
+    AssetId skyboxAsset = assets.load("star skybox", false, [&] { skybox.bake(generateStars(), pixelsPerTangent, jobs); return true; });
+    AssetId starFieldAsset = assets.load("star field", false, [&] {
+        Uint64 start = SDL_GetPerformanceCounter();
+        starField.generate(STAR_FIELD_COUNT, STAR_FIELD_INNER_RADIUS, STAR_FIELD_OUTER_RADIUS, STAR_FIELD_SEED, jobs);
+        SDL_Log("Generated %d stars in %.1f ms", starField.size(), FrameStats::milliseconds(SDL_GetPerformanceCounter() - start));
+        return true;
+    });
+
     // Initialize SDL
     if (!init()) { return 1; }
-    
-    // Read from .obj file and store the vertices/faces
-    std::vector<glm::vec3> sphereVertices;
-    std::vector<glm::vec3> sphereNormals;
-    std::vector<Face> sphereFaces;
-    loadOBJ("../models/sphere.obj", sphereVertices, sphereNormals, sphereFaces);
-
-    std::vector<glm::vec3> shipVertices;
-    std::vector<glm::vec3> shipNormals;
-    std::vector<Face> shipFaces;
-    loadOBJ("../models/Lab3_Ship.obj", shipVertices, shipNormals, shipFaces);
+
+    // Logs every asset that finished since the last call
+    std::vector<bool> assetReported(assets.count(), false);
+    auto reportAssets = [&] {
+        for (AssetId asset = 0; asset < assets.count(); asset++) {
+            if (assetReported[asset] || !assets.isDone(asset))
+                continue;
+            assetReported[asset] = true;
+            if (assets.isReady(asset))
+                SDL_Log("Loaded %s after %.1f ms", assets.name(asset).c_str(), assets.milliseconds(asset));
+            else
+                SDL_Log("Failed to load %s", assets.name(asset).c_str());
+        }
+    };
+
+    // The first frame only needs the meshes of the bodies, progress goes in the title
+    while (!assets.requiredReady()) {
+        reportAssets();
+        if (assets.failed()) {
+            quit();
+            return 1;
+        }
+        SDL_PumpEvents();
+        std::string title = "Loading assets: " + std::to_string(assets.doneCount()) + "/" + std::to_string(assets.count());
+        SDL_SetWindowTitle(window, title.c_str());
+        SDL_Delay(1);
+    }
+    reportAssets();
+    double requiredAssetMilliseconds = assets.elapsedMilliseconds();
 
     Camera camera = {glm::vec3(0, 0, -250), glm::vec3(0, 0, -245), glm::vec3(0, 1, 0)};
-    const float cameraMovementSpeed = 0.75f;
     const float horizontalRotationSpeed = 0.02f;
 
-    std::vector<glm::vec3> stars = generateStars();
-
-    std::vector<glm::vec3> VBO_sphere = setupVertexBufferObject(sphereVertices, sphereNormals, sphereFaces);
-    std::vector<glm::vec3> VBO_ship = setupVertexBufferObject(shipVertices, shipNormals, shipFaces);
+    // Mesh and material tables indexed by BodyDesc::mesh and BodyDesc::material
+    const std::array<MeshHandle, BODY_MESH_COUNT> bodyMeshes = {sphereMesh, rockMesh};
+    const std::array<Material, BODY_MATERIAL_COUNT> bodyMaterials = {
+        material<StarFragmentShader>(),
+        material<EarthPlanetFragmentShader>(),
+        material<MoonFragmentShader>(),
+        material<StripedPlanetFragmentShader>(),
+        material<RedPlanetFragmentShader>(),
+    };
 
     // Set up planets/stars
-    Planet* sun         = new Planet(VBO_sphere, glm::vec3(50), glm::vec3(0), starFragmentShader, 0.001f, 0.0f, 0.0f);
-    Planet* earth       = new Planet(VBO_sphere, glm::vec3(10), glm::vec3(80, 0, 0), earthPlanetFragmentShader, 0.05f, -0.007f, 80.0f);
-    Planet* moon        = new Planet(VBO_sphere, glm::vec3(2), glm::vec3(100, 2, 0), moonFragmentShader, 0.01f, 0.05f, 20.0f, earth->position);
-    Planet* gas_giant   = new Planet(VBO_sphere, glm::vec3(18), glm::vec3(120, 0, 0), stripedPlanetFragmentShader, 0.04f, 0.0005f, 120.0f);
-    Planet* red_planet  = new Planet(VBO_sphere, glm::vec3(25), glm::vec3(180, 0, 0), redPlanetFragmentShader, 0.06f, 0.01f, 180.0f);
+    // Speeds in radians per second. Center 0 is the origin and center i + 1 follows
+    // planet i, so the moon orbits the earth. Parents come before their moons.
+    std::vector<BodyDesc> planets = {
+        {.spinSpeed = 0.06f, .scale = 50.0f, .mass = 100000.0f, .material = BODY_MATERIAL_SUN},
+        {.orbitRadius = 80.0f, .orbitSpeed = -0.42f, .spinSpeed = 3.0f, .scale = 10.0f, .mass = 100.0f, .material = BODY_MATERIAL_EARTH},
+        {.orbitRadius = 20.0f, .orbitSpeed = 3.0f, .height = 2.0f, .spinSpeed = 0.6f, .scale = 2.0f, .mass = 1.0f, .center = 2, .material = BODY_MATERIAL_MOON},
+        {.orbitRadius = 120.0f, .orbitSpeed = 0.03f, .spinSpeed = 2.4f, .scale = 18.0f, .mass = 300.0f, .material = BODY_MATERIAL_GAS_GIANT},
+        {.orbitRadius = 180.0f, .orbitSpeed = 0.6f, .spinSpeed = 3.6f, .scale = 25.0f, .mass = 200.0f, .material = BODY_MATERIAL_RED_PLANET},
+    };
+    const int planetCount = static_cast<int>(planets.size());
+
+    // Planets are the first bodies, the asteroid belt orbits the sun after them
+    BodyStore bodies;
+    for (BodyDesc& planet : planets) {
+        planet.boundingRadius = sphereMesh->boundingRadius;
+        bodies.add(planet);
+    }
+    addAsteroidBelt(bodies, ASTEROID_COUNT, 1, rockMesh->boundingRadius);
+    std::vector<glm::vec3> bodyCenters(planetCount + 1, glm::vec3(0));
+    // Culling, picking and the ship's proximity query go through a BVH over the bodies'
+    // bounding spheres, refitted every frame and rebuilt once refits have loosened it
+    BoundingVolumeHierarchy bodyBvh;
+    std::vector<BodyId> visibleBodies;
+    std::vector<BodyId> meshBodies;
+    std::vector<BodyId> pointBodies;
+    std::array<std::vector<Instance>, BODY_MESH_COUNT> bodyInstances;
+
+    // Optional N-body mode, toggled with G: the bodies move under each other's gravity
+    // instead of along their closed-form orbits
+    GravitySimulation gravity;
+    bool gravityMode = false;
+
+    // Clicking a body picks it, the click is resolved once the frame's BVH is up to date
+    int pickX = -1;
+    int pickY = -1;
+    BodyId pickedBody = -1;
+
+    // Each planet gets a pivot node that follows its orbit and a body node under it
+    // with its scale and spin, so moons hang off the pivot without inheriting either
+    SceneGraph scene;
+    std::vector<SceneNode> planetPivots;
+    std::vector<SceneNode> planetNodes;
+    for (BodyId planet = 0; planet < planetCount; planet++) {
+        SceneNode parentPivot = planets[planet].center > 0 ? planetPivots[planets[planet].center - 1] : NO_PARENT;
+        SceneNode pivot = scene.addNode(parentPivot, bodies.offset(planet));
+        planetPivots.push_back(pivot);
+        planetNodes.push_back(scene.addNode(pivot, glm::vec3(0), glm::vec3(bodies.scale(planet)), bodies.spin(planet)));
+    }
+
+    // Every model shares its mesh instead of holding a copy
+    MeshRegistryStats meshStats = meshes.stats();
+    SDL_Log("Meshes: %zu, %zu KB shared by %zu handles (%zu KB if each held a copy)",
+        meshStats.meshes, meshStats.bytes / 1024, meshStats.handles, meshStats.copiedBytes / 1024);
+    SDL_Log("Quantized meshes: %zu, %zu KB of vertex data instead of %zu KB",
+        meshStats.quantizedMeshes, meshStats.bytes / 1024, meshStats.uncompressedBytes / 1024);
 
     float rotation = 0.0f;
     float moonRotation = 0.0f;
-    Uint32 frameStart, frameTime;
     float orbitAngle = 0.0f;
 
+    postChain.add(std::make_unique<BloomPass>());
+
+    // Frame N+1 is simulated and its geometry processed while frame N is
+    // rasterized; depth 1 runs every frame start to finish
+    RenderSettings settings;
+    FramePipeline<FramePacket> pipeline(jobs, renderFrame, 2);
+    Uint32 lastPresentTicks = SDL_GetTicks();
+
+    // Shows a rendered frame and reports its stats in the window title
+    bool firstFramePresented = false;
+    auto presentFrame = [&](std::unique_ptr<FramePacket> packet) {
+        present(packet->framebuffer);
+        if (!firstFramePresented) {
+            firstFramePresented = true;
+            SDL_Log("Time to first frame: %.1f ms (required assets ready after %.1f ms)", assets.elapsedMilliseconds(), requiredAssetMilliseconds);
+        }
+
+        Uint32 presentTicks = SDL_GetTicks();
+        Uint32 frameTime = presentTicks - lastPresentTicks;
+        lastPresentTicks = presentTicks;
+
+        // Calculate frames per second and update window title
+        const FrameStats& frameStats = packet->stats;
+        if (frameTime > 0) {
+            TextBuffer title;
+            title.append("FPS: %d", static_cast<int>(1000.0 / frameTime));  // Milliseconds to seconds
+            title.append(" | Latency: %u ms (depth %d)", presentTicks - packet->buildTicks, pipeline.depth());
+            title.append(" | Scene: %d s", static_cast<int>(packet->sceneTime));
+            if (packet->timeScale != 1.0)
+                title.append(" (x%g)", packet->timeScale);
+            title.append(" | Bodies: %d visible (%d meshes), update %.2f ms, BVH %s %.2f ms, cull %.2f ms",
+                packet->bodyCount, packet->bodyMeshCount, packet->bodyUpdateMilliseconds, packet->bodyBvhRebuilt ? "rebuild" : "refit",
+                packet->bodyRefitMilliseconds, packet->bodyCullMilliseconds);
+            if (packet->nearestBody >= 0)
+                title.append(" | Nearest: body %d at %d", packet->nearestBody, static_cast<int>(packet->nearestDistance));
+            if (packet->pickedBody >= 0)
+                title.append(" | Picked: body %d", packet->pickedBody);
+            if (packet->gravity)
+                title.append(" | Gravity: tree %.2f ms, forces %.2f ms", packet->gravityBuildMilliseconds, packet->gravityForceMilliseconds);
+            title.append(" | Stars: %d visible, project %.2f ms, splat %.2f ms",
+                packet->starField.visible, packet->starProjectMilliseconds, packet->starSplatMilliseconds);
+            const MeshletStats& meshlets = packet->meshletStats;
+            title.append(" | Meshlets: %d/%d drawn (frustum %d, backface %d, occluded %d)",
+                meshlets.tested - meshlets.outsideFrustum - meshlets.backfacing - meshlets.occluded, meshlets.tested,
+                meshlets.outsideFrustum, meshlets.backfacing, meshlets.occluded);
+            title.append(" | Shading: %d Mpix/s", static_cast<int>(frameStats.shadingMegapixelsPerSecond()));
+            title.append(" | Shaded pixels: %llu", static_cast<unsigned long long>(frameStats.shadedPixels));
+            title.append(" | Arena: %zu KB", packet->arena.bytesUsed() / 1024);
+            if (packet->settings.visibilityBuffer)
+                title.append(" | Visibility buffer");
+            if (packet->settings.hdr)
+                title.append(" | HDR resolve: %.2f ms", frameStats.resolveMilliseconds());
+            for (int i = 0; i < frameStats.passCount; i++)
+                title.append(" | %s: %.2f ms", frameStats.passTimings[i].name, FrameStats::milliseconds(frameStats.passTimings[i].counter));
+            title.append(" | Workers:");
+            for (int i = 0; i < frameStats.workerCount; i++)
+                title.append(" %d%%", static_cast<int>(frameStats.workerUtilisation(i) * 100.0));
+            title.append(" (%llu steals)", static_cast<unsigned long long>(frameStats.workerSteals()));
+            SDL_SetWindowTitle(window, title.text);
+        }
+
+        pipeline.recycle(std::move(packet));
+    };
+
+    // The scene advances in fixed steps of real time, independent of the frame rate
+    FixedTimestep timestep(SIMULATION_STEP);
+    Uint64 lastCounter = SDL_GetPerformanceCounter();
+    Camera previousCamera = camera;
+
+    // Scene clock the planets are evaluated at, runs timeScale times as fast as real time
+    double sceneTime = 0.0;
+    double previousSceneTime = 0.0;
+    double timeScale = 1.0;
+
+    // Once warmed up and with every asset in, one frame is built, rendered and presented
+    // with nothing else in flight and must not touch the heap: all transient data comes
+    // from the packet's arena. The whole loop iteration is counted, on the main thread
+    // and the job workers. A frame that allocates makes the program exit with 1.
+    const int ALLOCATION_CHECK_INTERVAL = 120;
+    int warmFrames = 0;
+    bool allocationsChecked = false;
+    int allocationFailures = 0;
+
     // Render loop
     bool running = true;
     SDL_Event event;
     while (running) {
-        frameStart = SDL_GetTicks();
+        bool checkAllocations = false;
+        if (assets.doneCount() == assets.count() && ++warmFrames % ALLOCATION_CHECK_INTERVAL == 0)
+            checkAllocations = checkAllocationsRepeatedly || !allocationsChecked;
+        Uint64 mainAllocations = 0;
+        Uint64 workerAllocations = 0;
+        if (checkAllocations) {
+            while (pipeline.inFlight() > 0) {
+                presentFrame(pipeline.waitCompleted());
+            }
+            mainAllocations = heapAllocationCount();
+            workerAllocations = jobs.heapAllocationCount();
+        }
+
+        std::unique_ptr<FramePacket> packet = pipeline.acquire();
+        packet->buildTicks = SDL_GetTicks();
+        packet->arena.reset();
+        reportAssets();
         while (SDL_PollEvent(&event) != 0) {
             if (event.type == SDL_QUIT)
                 running = false;
-            // Camera movement
+            if (event.type == SDL_MOUSEBUTTONDOWN && event.button.button == SDL_BUTTON_LEFT) {
+                pickX = event.button.x;
+                pickY = event.button.y;
+            }
+            // Camera movement is read from the held keys by the simulation steps
             if (event.type == SDL_KEYDOWN) {
                 if (event.key.keysym.sym == SDLK_ESCAPE)
                     running = false;
-                if (event.key.keysym.sym == SDLK_w) {
-                    // "W" key was pressed
-                    camera.MoveForward(cameraMovementSpeed);
+                if (event.key.keysym.sym == SDLK_v) {
+                    // Toggle visibility buffer (deferred) shading
+                    settings.visibilityBuffer = !settings.visibilityBuffer;
                 }
-                else if (event.key.keysym.sym == SDLK_s) {
-                    // "S" key was pressed
-                    camera.MoveBackward(cameraMovementSpeed);
+                else if (event.key.keysym.sym == SDLK_h) {
+                    // Toggle the HDR color target
+                    settings.hdr = !settings.hdr;
                 }
-                else if (event.key.keysym.sym == SDLK_d) {
-                    // "D" key was pressed
-                    camera.MoveRight(cameraMovementSpeed);
+                else if (event.key.keysym.sym == SDLK_b) {
+                    // Toggle bloom
+                    settings.bloom = !settings.bloom;
                 }
-                else if (event.key.keysym.sym == SDLK_a) {
-                    // "A" key was pressed
-                    camera.MoveLeft(cameraMovementSpeed);
+                else if (event.key.keysym.sym == SDLK_p) {
+                    // Cycle the pipeline depth between 1 and MAX_PIPELINE_DEPTH frames
+                    pipeline.setDepth(pipeline.depth() % MAX_PIPELINE_DEPTH + 1);
                 }
-                else if (event.key.keysym.sym == SDLK_q) {
-                    // Rotate the camera left (orbit)
-                    camera.Rotate(1.0f, 0.0f);
+                else if (event.key.keysym.sym == SDLK_LEFTBRACKET) {
+                    // Slow the scene clock down
+                    timeScale = std::max(timeScale * 0.5, MIN_TIME_SCALE);
                 }
-                else if (event.key.keysym.sym == SDLK_e) {
-                    // Rotate the camera right (orbit)
-                    camera.Rotate(-1.0f, 0.0f);
+                else if (event.key.keysym.sym == SDLK_RIGHTBRACKET) {
+                    // Speed the scene clock up
+                    timeScale = std::min(timeScale * 2.0, MAX_TIME_SCALE);
+                }
+                else if (event.key.keysym.sym == SDLK_g) {
+                    // Toggle the gravity simulation, starting from the current positions
+                    gravityMode = !gravityMode;
+                    if (gravityMode)
+                        startGravity(bodies, gravity);
                 }
             }
         }        
 
-        // Clear the buffer
-        clear();
+        // Advance the simulation in fixed steps for the real time that passed
+        Uint64 counter = SDL_GetPerformanceCounter();
+        int steps = timestep.advance(static_cast<double>(counter - lastCounter) / static_cast<double>(SDL_GetPerformanceFrequency()));
+        lastCounter = counter;
+        const Uint8* keys = SDL_GetKeyboardState(nullptr);
+        int gravitySteps = 0;
+        for (int step = 0; step < steps; step++) {
+            previousCamera = camera;
+            moveCamera(camera, keys, static_cast<float>(timestep.step()));
+
+            previousSceneTime = sceneTime;
+            sceneTime += timestep.step() * timeScale;
+
+            if (gravityMode && gravitySteps < MAX_GRAVITY_STEPS_PER_FRAME) {
+                gravity.step(static_cast<float>(std::min(timestep.step() * timeScale, MAX_GRAVITY_STEP)), jobs);
+                gravitySteps++;
+            }
+        }
+
+        // The frame shows the scene between the last two steps. The planets are
+        // evaluated at that exact time rather than blended.
+        float alpha = timestep.alpha();
+        Camera frameCamera = Camera::interpolate(previousCamera, camera, alpha);
+        double frameSceneTime = previousSceneTime + (sceneTime - previousSceneTime) * alpha;
+        packet->sceneTime = frameSceneTime;
+        packet->timeScale = timeScale;
+
 
         // Get the rotation quaternion
-        glm::quat cameraRotation = camera.getCameraRotation();
+        glm::quat cameraRotation = frameCamera.getCameraRotation();
 
         // Calculate matrixes for rendering
-        uniforms.view = createViewMatrix(camera);
+        Uniforms uniforms;
+        uniforms.view = createViewMatrix(frameCamera);
         uniforms.projection = createProjectionMatrix(SCREEN_WIDTH, SCREEN_HEIGHT);
         uniforms.viewport = createViewportMatrix(SCREEN_WIDTH, SCREEN_HEIGHT);
 
-        // Star sphere model matrix
-        uniforms.model = createModelMatrix(glm::vec3(1000), glm::vec3(0));
-        drawStars(stars, uniforms);
-
-        // Render sun
-        uniforms.model = sun->getModelMatrix();
-        activeShader = sun->shader;
-        render(sun->vertexBufferObject, camera);
-        sun->update();
-
-        // Render earth
-        uniforms.model = earth->getModelMatrix();
-        activeShader = earth->shader;
-        render(earth->vertexBufferObject, camera);
-        earth->update();
-
-        // Render moon
-        uniforms.model = moon->getModelMatrix();
-        activeShader = moon->shader;
-        render(moon->vertexBufferObject, camera);
-        moon->orbitTarget = earth->position;
-        moon->update();
-
-        // Render gas giant
-        uniforms.model = gas_giant->getModelMatrix();
-        activeShader = gas_giant->shader;
-        render(gas_giant->vertexBufferObject, camera);
-        gas_giant->update();
-
-        // Render red_planet
-        uniforms.model = red_planet->getModelMatrix();
-        activeShader = red_planet->shader;
-        render(red_planet->vertexBufferObject, camera);
-        red_planet->update();
+        packet->skyboxUniforms = uniforms;
+        packet->skybox = assets.isReady(skyboxAsset) ? &skybox : nullptr;
+
+        // The star field is projected and binned here, splatted by renderFrame()
+        packet->starField = ProjectedStars();
+        if (assets.isReady(starFieldAsset)) {
+            Uint64 starStart = SDL_GetPerformanceCounter();
+            packet->starField = starField.project(uniforms.projection * uniforms.view, uniforms.viewport, SCREEN_WIDTH, SCREEN_HEIGHT, BLOCK_SIZE, packet->arena, jobs);
+            packet->starProjectMilliseconds = FrameStats::milliseconds(SDL_GetPerformanceCounter() - starStart);
+        }
+
+        // Evaluate every body, move the planets' scene nodes, then place the bodies
+        // around the centers those nodes give. In the gravity mode the simulation places
+        // the bodies and only the spins come from update().
+        Uint64 bodyStart = SDL_GetPerformanceCounter();
+        bodies.update(frameSceneTime, jobs);
+        if (gravityMode) {
+            jobs.parallelFor(bodies.size(), [&](int begin, int end) {
+                for (BodyId body = begin; body < end; body++) {
+                    bodies.setPosition(body, gravity.positionAt(body, alpha));
+                }
+            });
+        }
+        for (BodyId planet = 0; planet < planetCount; planet++) {
+            glm::vec3 translation = bodies.offset(planet);
+            if (gravityMode) {
+                int center = bodies.center(planet);
+                translation = bodies.position(planet) - (center > 0 ? bodies.position(center - 1) : glm::vec3(0));
+            }
+            scene.setTranslation(planetPivots[planet], translation);
+            scene.setRotation(planetNodes[planet], bodies.spin(planet));
+        }
+        scene.updateWorldTransforms();
+        if (!gravityMode) {
+            for (int planet = 0; planet < planetCount; planet++) {
+                bodyCenters[planet + 1] = glm::vec3(scene.worldMatrix(planetPivots[planet])[3]);
+            }
+            bodies.resolve(bodyCenters, jobs);
+        }
+        packet->gravity = gravityMode;
+        packet->gravityBuildMilliseconds = gravity.buildSeconds() * 1000.0;
+        packet->gravityForceMilliseconds = gravity.forceSeconds() * 1000.0;
+        Uint64 refitStart = SDL_GetPerformanceCounter();
+        packet->bodyUpdateMilliseconds = FrameStats::milliseconds(refitStart - bodyStart);
+
+        // Bring the BVH up to date with where the bodies are now
+        SphereBounds bodyBounds = bodies.bounds();
+        packet->bodyBvhRebuilt = bodyBvh.empty();
+        if (!bodyBvh.empty()) {
+            bodyBvh.refit(bodyBounds, jobs);
+            packet->bodyBvhRebuilt = bodyBvh.degraded();
+        }
+        if (packet->bodyBvhRebuilt)
+            bodyBvh.build(bodyBounds, jobs);
+        Uint64 cullStart = SDL_GetPerformanceCounter();
+        packet->bodyRefitMilliseconds = FrameStats::milliseconds(cullStart - refitStart);
+
+        if (pickX >= 0) {
+            glm::vec3 rayOrigin;
+            glm::vec3 rayDirection;
+            pixelRay(uniforms, pickX, pickY, rayOrigin, rayDirection);
+            pickedBody = bodyBvh.raycast(rayOrigin, rayDirection, std::numeric_limits<float>::max()).object;
+            pickX = -1;
+        }
+        packet->pickedBody = pickedBody;
+
+        // Cull through the BVH, then draw the bodies as instances of their mesh or as
+        // points. The BVH visits nearer subtrees first, so instances are drawn roughly
+        // front to back and the depth test rejects more of the later ones.
+        glm::mat4 viewProjection = uniforms.projection * uniforms.view;
+        bodyBvh.cull(Frustum::fromMatrix(viewProjection), frameCamera.cameraPosition, visibleBodies);
+        bodies.splitByScreenSize(visibleBodies, viewProjection, uniforms.projection[1][1] * SCREEN_HEIGHT * 0.5f, meshBodies, pointBodies);
+        for (std::vector<Instance>& instances : bodyInstances) {
+            instances.clear();
+        }
+        for (BodyId body : meshBodies) {
+            std::vector<Instance>& instances = bodyInstances[bodies.mesh(body)];
+            if (body >= planetCount && instances.size() >= MAX_ASTEROID_MESHES) {
+                pointBodies.push_back(body);
+                continue;
+            }
+            // Planets take the matrix of their scene node
+            glm::mat4 model = body < planetCount ? scene.worldMatrix(planetNodes[body]) : bodies.modelMatrix(body);
+            instances.push_back(Instance{model, bodyMaterials[bodies.material(body)]});
+        }
+        for (int mesh = 0; mesh < BODY_MESH_COUNT; mesh++) {
+            renderInstanced(bodyMeshes[mesh]->view(), uniforms, frameCamera, bodyInstances[mesh]);
+        }
+
+        // The planets drawn this frame hide the meshlets behind them
+        hiZBuffer.clear();
+        for (BodyId body : meshBodies) {
+            if (body < planetCount)
+                hiZBuffer.addSphere(bodies.position(body), bodies.boundingRadius(body), uniforms.view, uniforms.projection, uniforms.viewport);
+        }
+        hiZBuffer.buildPyramid();
+
+        std::span<glm::vec3> bodyPoints = packet->arena.local().allocateArray<glm::vec3>(pointBodies.size());
+        for (size_t i = 0; i < pointBodies.size(); i++) {
+            bodyPoints[i] = bodies.position(pointBodies[i]);
+        }
+        packet->bodyPoints = bodyPoints;
+        packet->bodyUniforms = uniforms;
+        packet->bodyCount = static_cast<int>(visibleBodies.size());
+        packet->bodyMeshCount = static_cast<int>(visibleBodies.size() - pointBodies.size());
+        packet->bodyCullMilliseconds = FrameStats::milliseconds(SDL_GetPerformanceCounter() - cullStart);
 
         // Render ship
         glm::vec3 targetOffset = glm::vec3(0, 0.4, 0);
-        uniforms.model = createModelMatrix(glm::vec3(0.1), camera.targetPosition - targetOffset, 1.57);
+        uniforms.model = createModelMatrix(glm::vec3(0.1), frameCamera.targetPosition - targetOffset, 1.57);
         // Apply the camera's rotation to the ship's model matrix
         uniforms.model *= glm::mat4_cast(cameraRotation);
 
-        activeShader = shipFragmentShader;
-        render(VBO_ship, camera);
+        if (assets.isReady(shipAsset))
+            render<ShipFragmentShader>(shipMesh->view(), uniforms, frameCamera);
 
-        // Present the framebuffer to the screen
-        SDL_RenderPresent(renderer);
+        // What the ship is closest to
+        BvhHit nearest = bodyBvh.nearest(frameCamera.targetPosition - targetOffset, std::numeric_limits<float>::max());
+        packet->nearestBody = nearest.object;
+        packet->nearestDistance = nearest.distance;
 
-        frameTime = SDL_GetTicks() - frameStart;
+        // Snapshot the frame: settings, then the recorded draws with their geometry processed
+        packet->settings = settings;
+        packet->meshletStats = MeshletStats();
+        processFrameGeometry(settings, packet->arena, packet->meshletStats);
+        packet->draws.swap(drawCalls);
+        drawCalls.clear();
 
-        // Calculate frames per second and update window title
-        if (frameTime > 0) {
-            std::ostringstream titleStream;
-            titleStream << "FPS: " << static_cast<int>(1000.0 / frameTime);  // Milliseconds to seconds
-            SDL_SetWindowTitle(window, titleStream.str().c_str());
+        // Hand the frame to the pipeline, then present finished frames until
+        // fewer than depth() are in flight
+        pipeline.submit(std::move(packet));
+        if (checkAllocations) {
+            presentFrame(pipeline.waitCompleted());
+            mainAllocations = heapAllocationCount() - mainAllocations;
+            workerAllocations = jobs.heapAllocationCount() - workerAllocations;
+            if (mainAllocations + workerAllocations == 0) {
+                if (!allocationsChecked)
+                    SDL_Log("Steady state: no heap allocations per frame");
+            } else {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "Steady state: %llu heap allocations in one frame (%llu on the main thread, %llu on the workers)",
+                    static_cast<unsigned long long>(mainAllocations + workerAllocations), static_cast<unsigned long long>(mainAllocations),
+                    static_cast<unsigned long long>(workerAllocations));
+                allocationFailures++;
+            }
+            allocationsChecked = true;
+        }
+        while (pipeline.inFlight() >= pipeline.depth()) {
+            presentFrame(pipeline.waitCompleted());
         }
+        while (std::unique_ptr<FramePacket> done = pipeline.tryCompleted()) {
+            presentFrame(std::move(done));
+        }
+    }
+
+    while (pipeline.inFlight() > 0) {
+        presentFrame(pipeline.waitCompleted());
     }
 
     quit();
-    exit(0);
+    exit(allocationFailures > 0 ? 1 : 0);
 }